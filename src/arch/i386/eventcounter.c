@@ -69,6 +69,8 @@ typedef u_int64_t eventcounter_t;
  **/
 #include "p6counter.h"
 
+#define MAX_EVENTCOUNTERS	NUM_P6HWC
+
 #define select_eventcounter(ctr,str) select_p6counter((ctr),strtol((str),NULL,0))
 #define select_eventcounter_defaults() {select_eventcounter(0,"0x79");select_eventcounter(1,"0x79");}
 
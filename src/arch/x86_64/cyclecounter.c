@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * cyclecounter.c -- interface to the time stamp counter on x86-64
+ *
+ * See arch/i386/cyclecounter.c for the interface each architecture
+ * must provide. In addition to that interface, this file defines
+ * CYCLE_COUNTER_AUTOMULT and provides
+ *	float cycle_counter_multiplier(void)
+ * which returns the microseconds per counter tick, so that the driver
+ * can pass "auto" instead of a measured clock multiplier.
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cpuid.h>
+
+/*
+ * On x86-64 we can pass 64-bit values around freely, so there is no
+ * reason to truncate: clk_t is as wide as the counter itself. A 32-bit
+ * clk_t wraps in about a second on a modern part.
+ */
+typedef unsigned long long clk_t;
+typedef unsigned long long internal_clk_t;
+#define CLKTFMT		"%llu"
+#define CLKTSTR(x) 	strtoull(x, NULL, 10)
+
+/*
+ * Read function: read the time stamp counter.
+ *
+ * RDTSCP does not execute until all prior instructions have executed,
+ * and the trailing LFENCE keeps later instructions from starting before
+ * the counter is read, so the timed region cannot leak across either
+ * end. The leading LFENCE additionally waits for prior loads to
+ * complete. Build with -DNO_RDTSCP for parts that lack RDTSCP.
+ */
+#ifndef NO_RDTSCP
+#define read_cycle_counter(res_p) do {					\
+	unsigned int __lo, __hi, __aux;					\
+	__asm __volatile ("lfence; rdtscp; lfence"			\
+	    : "=a" (__lo), "=d" (__hi), "=c" (__aux)			\
+	    : /* no input regs */					\
+	    : "memory");						\
+	*(res_p) = ((internal_clk_t)__hi << 32) | __lo;			\
+} while (0)
+#else
+#define read_cycle_counter(res_p) do {					\
+	unsigned int __lo, __hi;					\
+	__asm __volatile ("lfence; rdtsc; lfence"			\
+	    : "=a" (__lo), "=d" (__hi)					\
+	    : /* no input regs */					\
+	    : "memory");						\
+	*(res_p) = ((internal_clk_t)__hi << 32) | __lo;			\
+} while (0)
+#endif
+
+/*
+ * Zero function: we can't zero the TSC from user level, but this is
+ * called once from init_timing(), so use it to check that the counter
+ * is usable as a clock at all.
+ */
+void
+zero_cycle_counter()
+{
+	unsigned int a, b, c, d;
+
+#ifndef NO_RDTSCP
+	if (!__get_cpuid(0x80000001, &a, &b, &c, &d) || !(d & (1 << 27))) {
+		fprintf(stderr, "cyclecounter: processor lacks RDTSCP; "
+			"rebuild with -DNO_RDTSCP\n");
+		exit(1);
+	}
+#endif
+	/*
+	 * Without an invariant TSC the counter rate follows frequency
+	 * scaling and stops in deep C-states, so ticks are not time.
+	 */
+	if (!__get_cpuid(0x80000007, &a, &b, &c, &d) || !(d & (1 << 8)))
+		fprintf(stderr, "cyclecounter: warning: TSC is not invariant; "
+			"results will vary with CPU frequency\n");
+}
+
+/*
+ * Derive the clock multiplier (microseconds per tick).
+ *
+ * If CPUID leaf 0x15 reports the crystal frequency, the TSC rate is
+ * exact. Otherwise, calibrate against the monotonic clock over
+ * CALIBRATE_NSEC, taking the median of a few tries to discard
+ * preemption.
+ */
+#define CYCLE_COUNTER_AUTOMULT
+#define CALIBRATE_NSEC		20000000LL
+#define CALIBRATE_TRIES		5
+
+float
+cycle_counter_multiplier()
+{
+	unsigned int a, b, c, d;
+	internal_clk_t c0, c1;
+	struct timespec t0, t1;
+	long long ns;
+	double hz[CALIBRATE_TRIES], tmp;
+	int i, j;
+
+	if (__get_cpuid(0, &a, &b, &c, &d) && a >= 0x15) {
+		__cpuid(0x15, a, b, c, d);
+		if (a != 0 && b != 0 && c != 0)
+			return ((float)(1000000.0 / ((double)c * b / a)));
+	}
+
+	for (i = 0; i < CALIBRATE_TRIES; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		read_cycle_counter(&c0);
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			ns = (long long)(t1.tv_sec - t0.tv_sec) * 1000000000LL
+				+ (t1.tv_nsec - t0.tv_nsec);
+		} while (ns < CALIBRATE_NSEC);
+		read_cycle_counter(&c1);
+		hz[i] = (double)(c1 - c0) * 1000000000.0 / (double)ns;
+
+		/* keep hz[0..i] sorted */
+		for (j = i; j > 0 && hz[j-1] > hz[j]; j--) {
+			tmp = hz[j]; hz[j] = hz[j-1]; hz[j-1] = tmp;
+		}
+	}
+	return ((float)(1000000.0 / hz[CALIBRATE_TRIES/2]));
+}
+
+#else /* __x86_64__ */
+#error Cycle counter support on x86-64 requires gcc
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * memkernels.c -- vector read/write/copy loops for x86-64
+ *
+ * Each kernel moves n bytes, where n is a multiple of MEMKERN_GRAN,
+ * four vectors per loop trip. The AVX2 and AVX-512 kernels are compiled
+ * with function-level target attributes, so the binaries still run on
+ * CPUs without them; lib_memkern.c checks CPUID before using one.
+ * Read kernels add every vector into one of four accumulators (like
+ * the scalar loop, which adds every word) and return the sum so the
+ * loads cannot be optimized away. Loads and stores are unaligned, so
+ * any buffer will do, except that the "nt" kernels' non-temporal
+ * stores, which bypass the caches, need a 16-byte aligned destination.
+ */
+
+#include <immintrin.h>
+
+#define SSE2	__attribute__((target("sse2")))
+#define AVX2	__attribute__((target("avx2")))
+#define AVX512	__attribute__((target("avx512f")))
+
+/*
+ * SSE2, 16 bytes per vector
+ */
+static unsigned long SSE2
+rd_sse2(void *buf, unsigned long n)
+{
+	__m128i *p = buf, *end = (__m128i *)((char *)buf + n);
+	__m128i a0 = _mm_setzero_si128(), a1 = a0, a2 = a0, a3 = a0;
+
+	for (; p < end; p += 4) {
+		a0 = _mm_add_epi32(a0, _mm_loadu_si128(p));
+		a1 = _mm_add_epi32(a1, _mm_loadu_si128(p + 1));
+		a2 = _mm_add_epi32(a2, _mm_loadu_si128(p + 2));
+		a3 = _mm_add_epi32(a3, _mm_loadu_si128(p + 3));
+	}
+	a0 = _mm_add_epi32(_mm_add_epi32(a0, a1), _mm_add_epi32(a2, a3));
+	return ((unsigned long)_mm_cvtsi128_si32(a0));
+}
+
+static void SSE2
+wr_sse2(void *buf, unsigned long n)
+{
+	__m128i *p = buf, *end = (__m128i *)((char *)buf + n);
+	__m128i v = _mm_set1_epi32(1);
+
+	for (; p < end; p += 4) {
+		_mm_storeu_si128(p, v);
+		_mm_storeu_si128(p + 1, v);
+		_mm_storeu_si128(p + 2, v);
+		_mm_storeu_si128(p + 3, v);
+	}
+}
+
+static void SSE2
+cp_sse2(void *dst, void *src, unsigned long n)
+{
+	__m128i *s = src, *d = dst, *end = (__m128i *)((char *)src + n);
+
+	for (; s < end; s += 4, d += 4) {
+		_mm_storeu_si128(d, _mm_loadu_si128(s));
+		_mm_storeu_si128(d + 1, _mm_loadu_si128(s + 1));
+		_mm_storeu_si128(d + 2, _mm_loadu_si128(s + 2));
+		_mm_storeu_si128(d + 3, _mm_loadu_si128(s + 3));
+	}
+}
+
+/*
+ * AVX2, 32 bytes per vector
+ */
+static unsigned long AVX2
+rd_avx2(void *buf, unsigned long n)
+{
+	__m256i *p = buf, *end = (__m256i *)((char *)buf + n);
+	__m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+
+	for (; p < end; p += 4) {
+		a0 = _mm256_add_epi32(a0, _mm256_loadu_si256(p));
+		a1 = _mm256_add_epi32(a1, _mm256_loadu_si256(p + 1));
+		a2 = _mm256_add_epi32(a2, _mm256_loadu_si256(p + 2));
+		a3 = _mm256_add_epi32(a3, _mm256_loadu_si256(p + 3));
+	}
+	a0 = _mm256_add_epi32(_mm256_add_epi32(a0, a1),
+			      _mm256_add_epi32(a2, a3));
+	return ((unsigned long)_mm256_extract_epi32(a0, 0));
+}
+
+static void AVX2
+wr_avx2(void *buf, unsigned long n)
+{
+	__m256i *p = buf, *end = (__m256i *)((char *)buf + n);
+	__m256i v = _mm256_set1_epi32(1);
+
+	for (; p < end; p += 4) {
+		_mm256_storeu_si256(p, v);
+		_mm256_storeu_si256(p + 1, v);
+		_mm256_storeu_si256(p + 2, v);
+		_mm256_storeu_si256(p + 3, v);
+	}
+}
+
+static void AVX2
+cp_avx2(void *dst, void *src, unsigned long n)
+{
+	__m256i *s = src, *d = dst, *end = (__m256i *)((char *)src + n);
+
+	for (; s < end; s += 4, d += 4) {
+		_mm256_storeu_si256(d, _mm256_loadu_si256(s));
+		_mm256_storeu_si256(d + 1, _mm256_loadu_si256(s + 1));
+		_mm256_storeu_si256(d + 2, _mm256_loadu_si256(s + 2));
+		_mm256_storeu_si256(d + 3, _mm256_loadu_si256(s + 3));
+	}
+}
+
+/*
+ * AVX-512, 64 bytes per vector
+ */
+static unsigned long AVX512
+rd_avx512(void *buf, unsigned long n)
+{
+	__m512i *p = buf, *end = (__m512i *)((char *)buf + n);
+	__m512i a0 = _mm512_setzero_si512(), a1 = a0, a2 = a0, a3 = a0;
+
+	for (; p < end; p += 4) {
+		a0 = _mm512_add_epi32(a0, _mm512_loadu_si512(p));
+		a1 = _mm512_add_epi32(a1, _mm512_loadu_si512(p + 1));
+		a2 = _mm512_add_epi32(a2, _mm512_loadu_si512(p + 2));
+		a3 = _mm512_add_epi32(a3, _mm512_loadu_si512(p + 3));
+	}
+	a0 = _mm512_add_epi32(_mm512_add_epi32(a0, a1),
+			      _mm512_add_epi32(a2, a3));
+	return ((unsigned long)_mm512_reduce_add_epi32(a0));
+}
+
+static void AVX512
+wr_avx512(void *buf, unsigned long n)
+{
+	__m512i *p = buf, *end = (__m512i *)((char *)buf + n);
+	__m512i v = _mm512_set1_epi32(1);
+
+	for (; p < end; p += 4) {
+		_mm512_storeu_si512(p, v);
+		_mm512_storeu_si512(p + 1, v);
+		_mm512_storeu_si512(p + 2, v);
+		_mm512_storeu_si512(p + 3, v);
+	}
+}
+
+static void AVX512
+cp_avx512(void *dst, void *src, unsigned long n)
+{
+	__m512i *s = src, *d = dst, *end = (__m512i *)((char *)src + n);
+
+	for (; s < end; s += 4, d += 4) {
+		_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+		_mm512_storeu_si512(d + 1, _mm512_loadu_si512(s + 1));
+		_mm512_storeu_si512(d + 2, _mm512_loadu_si512(s + 2));
+		_mm512_storeu_si512(d + 3, _mm512_loadu_si512(s + 3));
+	}
+}
+
+/*
+ * rep movsb / rep stosb: fast on CPUs with ERMS (enhanced rep movsb)
+ */
+static void
+wr_movsb(void *buf, unsigned long n)
+{
+	__asm__ __volatile__("rep stosb"
+			     : "+D" (buf), "+c" (n)
+			     : "a" (1)
+			     : "memory");
+}
+
+static void
+cp_movsb(void *dst, void *src, unsigned long n)
+{
+	__asm__ __volatile__("rep movsb"
+			     : "+D" (dst), "+S" (src), "+c" (n)
+			     :
+			     : "memory");
+}
+
+/*
+ * SSE2 non-temporal (streaming) stores
+ */
+static void SSE2
+wr_nt(void *buf, unsigned long n)
+{
+	__m128i *p = buf, *end = (__m128i *)((char *)buf + n);
+	__m128i v = _mm_set1_epi32(1);
+
+	for (; p < end; p += 4) {
+		_mm_stream_si128(p, v);
+		_mm_stream_si128(p + 1, v);
+		_mm_stream_si128(p + 2, v);
+		_mm_stream_si128(p + 3, v);
+	}
+	_mm_sfence();
+}
+
+static void SSE2
+cp_nt(void *dst, void *src, unsigned long n)
+{
+	__m128i *s = src, *d = dst, *end = (__m128i *)((char *)src + n);
+
+	for (; s < end; s += 4, d += 4) {
+		_mm_stream_si128(d, _mm_loadu_si128(s));
+		_mm_stream_si128(d + 1, _mm_loadu_si128(s + 1));
+		_mm_stream_si128(d + 2, _mm_loadu_si128(s + 2));
+		_mm_stream_si128(d + 3, _mm_loadu_si128(s + 3));
+	}
+	_mm_sfence();
+}
+
+/*
+ * CPU feature tests
+ */
+static int
+has_sse2()
+{
+	return (__builtin_cpu_supports("sse2"));
+}
+
+static int
+has_avx2()
+{
+	return (__builtin_cpu_supports("avx2"));
+}
+
+static int
+has_avx512()
+{
+	return (__builtin_cpu_supports("avx512f"));
+}
+
+static int
+has_any()
+{
+	return (1);
+}
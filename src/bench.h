@@ -37,6 +37,7 @@
 
 char	last();
 int 	parse_bytes();
+int	raise_fd_limit();
 
 void		init_timing();
 unsigned int	gen_iterations();
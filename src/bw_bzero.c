@@ -57,14 +57,16 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations size\n", av[0],
-			counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 3) {
+		fprintf(stderr, "Usage: %s%s%s iterations size\n", av[0],
+			counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -96,9 +98,11 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_memzero(niter, &totaltime);	/* get cached write bandwidth */
-
-	output_bandwidth(niter * bytes, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_memzero(niter, &totaltime);	/* get cached write bandwidth */
+		output_bandwidth((double)niter * bytes, totaltime);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -27,18 +27,45 @@
 /*
  * bw_file_rd.c - time reading & summing of a file
  *
- * Usage: bw_file_rd size_to_read read_increment file
+ * Usage: bw_file_rd [-t threads [-C cpulist]] [-U depth[,buf][,file]
+ *		[,sqpoll]] [-D] [-R] [-F sequential|random|dontneed]
+ *		ignored size_to_read read_increment file
  *
  * The intent is that the file is in memory, so cold cache numbers taken
  * with this benchmark are not very useful, as they include disk timing.
  * Disk benchmarking should be done with hbdd.
  *
+ * The options change that, for measuring the storage path instead:
+ *
+ *	-U	read through an io_uring with depth reads in flight (see
+ *		lib_uring.c) rather than with one read() at a time
+ *	-D	open the file O_DIRECT, bypassing the page cache; the
+ *		buffers are page-aligned, and read_increment must be a
+ *		multiple of the device's block size
+ *	-R	read the read_increment-sized blocks in a random order
+ *		(each once) rather than sequentially
+ *	-F	posix_fadvise() the file SEQUENTIAL or RANDOM, or, with
+ *		"dontneed", flush it and drop it from the page cache
+ *		before each run so that every run reads it cold
+ *
+ * With -t (see lib_thread.c), size_to_read is split into one region per
+ * thread, and each thread reads its own region with pread(), or through
+ * a ring of its own with -U, all at once. The result is the aggregate
+ * bandwidth followed by each thread's own, which shows how fairly the
+ * device was shared.
+ *
+ * With -H, each read is timed as well, from submission to completion,
+ * and p50/p90/p99/p99.9/max of those times follow the bandwidth. This
+ * is not available with more than one thread.
+ *
  * Based on:
  *	$lmbenchId: bw_file_rd.c,v 1.2 1995/03/11 02:19:56 lm Exp $
  */
 char	*id = "$Id: bw_file_rd.c,v 1.4 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include "common.c"
+#include "lib_thread.c"
+#include "lib_uring.c"
 
 #include <fcntl.h>
 #include <stdlib.h>
@@ -53,6 +80,21 @@ char	*id = "$Id: bw_file_rd.c,v 1.4 1997/06/27 00:33:58 abrown Exp $\n";
  * the structure parallel the other tests.
  */
 int 	do_fileread();
+unsigned int	read_blocks();
+void	fileread_thread(int id, int num_iter);
+
+/*
+ * What each reader (the one thread, or each of the -t threads) needs
+ */
+struct reader {
+	char		*buf;		/* read() buffer */
+#ifdef HAVE_URING
+	struct uring	ring;		/* -U: the ring */
+	char		*bufs;		/* -U: one buffer per read in flight */
+	int		*freeslots;	/* -U: buffers not in use */
+	clk_t		*stamps;	/* -U -H: submission time per buffer */
+#endif
+};
 
 /*
  * Global variables: these are the parameters required by the worker routine.
@@ -63,6 +105,113 @@ int 	do_fileread();
 unsigned int 	bytes;		/* the number of bytes to be read */
 unsigned int	bufsize;
 int		fd;		/* file descriptor of open file */
+int		direct = 0;	/* -D: O_DIRECT */
+int		randomize = 0;	/* -R: random block order */
+int		advice = 0;	/* -F sequential or random */
+int		drop_cache = 0;	/* -F dontneed */
+unsigned int	nblocks;	/* bufsize blocks per reader */
+unsigned int	*order;		/* -R: block numbers in read order */
+struct reader	readers[MAX_THREADS];
+
+static char *file_argstring = " [-D] [-R] [-F sequential|random|dontneed]";
+
+/*
+ * Parse the file access options, in any order; like parse_counter_args,
+ * they are consumed and av[0] is left in place. Returns 0 on success, 1
+ * on error.
+ */
+int
+parse_file_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+	int n;
+
+	for (;;) {
+		n = 0;
+		if (*acp >= 2 && !strcmp((*avp)[1], "-D")) {
+#ifndef O_DIRECT
+			fprintf(stderr, "-D: not supported on this system\n");
+			return (1);
+#endif
+			direct = 1;
+			n = 1;
+		} else if (*acp >= 2 && !strcmp((*avp)[1], "-R")) {
+			randomize = 1;
+			n = 1;
+		} else if (*acp >= 3 && !strcmp((*avp)[1], "-F")) {
+#ifdef POSIX_FADV_DONTNEED
+			if (!strcmp((*avp)[2], "sequential"))
+				advice = POSIX_FADV_SEQUENTIAL;
+			else if (!strcmp((*avp)[2], "random"))
+				advice = POSIX_FADV_RANDOM;
+			else if (!strcmp((*avp)[2], "dontneed"))
+				drop_cache = 1;
+			else
+				return (1);
+#else
+			fprintf(stderr, "-F: not supported on this system\n");
+			return (1);
+#endif
+			n = 2;
+		}
+		if (n == 0)
+			return (0);
+		*acp -= n;
+		*avp += n;
+		(*avp)[0] = av0;
+	}
+}
+
+/*
+ * Set up reader r's buffers, and its ring if -U was given
+ */
+void
+reader_init(r)
+	struct reader *r;
+{
+#ifdef HAVE_URING
+	struct iovec	*iov;
+	int		i;
+#endif
+
+	if ((r->buf = valloc(bufsize)) == NULL) {	/* aligned, for -D */
+		perror("valloc");
+		exit(1);
+	}
+	bzero(r->buf, bufsize);
+#ifdef HAVE_URING
+	if (uring_depth == 0)
+		return;
+	if (uring_init(&r->ring, uring_depth) == -1) {
+		perror("io_uring_setup");
+		exit(1);
+	}
+	r->bufs = valloc(uring_depth * bufsize);
+	r->freeslots = (int *)malloc(uring_depth * sizeof(int));
+	r->stamps = (clk_t *)malloc(uring_depth * sizeof(clk_t));
+	iov = (struct iovec *)malloc(uring_depth * sizeof(*iov));
+	if (!r->bufs || !r->freeslots || !r->stamps || !iov) {
+		perror("malloc");
+		exit(1);
+	}
+	bzero(r->bufs, uring_depth * bufsize);
+	for (i = 0; i < uring_depth; i++) {
+		iov[i].iov_base = r->bufs + i * bufsize;
+		iov[i].iov_len = bufsize;
+	}
+	if ((uring_flags & URING_BUF) &&
+	    uring_register_buffers(&r->ring, iov, uring_depth) == -1) {
+		perror("IORING_REGISTER_BUFFERS");
+		exit(1);
+	}
+	if ((uring_flags & URING_FILE) &&
+	    uring_register_files(&r->ring, &fd, 1) == -1) {
+		perror("IORING_REGISTER_FILES");
+		exit(1);
+	}
+	free(iov);
+#endif
+}
 
 int
 main(ac, av)
@@ -70,15 +219,26 @@ main(ac, av)
 	char  **av;
 {
 	clk_t		totaltime;
+	int		run;
 	int		niter;
+	unsigned int	i, j, tmp;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 5) {
-		fprintf(stderr, "Usage: %s%s ignored sizetoread readincrement file\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || parse_thread_args(&ac, &av) ||
+	    parse_uring_args(&ac, &av) || parse_file_args(&ac, &av) ||
+	    ac != 5) {
+		fprintf(stderr, "Usage: %s%s%s%s%s%s%s ignored sizetoread "
+			"readincrement file\n", av[0], counter_argstring,
+			repeat_argstring, sample_argstring, thread_argstring,
+			uring_argstring, file_argstring);
+		exit(1);
+	}
+	if (sample_batch && nthreads > 1) {
+		fprintf(stderr, "%s: -H needs a single thread\n", av[0]);
 		exit(1);
 	}
 
@@ -86,7 +246,15 @@ main(ac, av)
 	niter = atoi(av[1]);
 	bytes = parse_bytes(av[2]);
 	bufsize = parse_bytes(av[3]);
+#ifdef O_DIRECT
+	CHK(fd = open(av[4], direct ? O_RDONLY|O_DIRECT : O_RDONLY));
+#else
 	CHK(fd = open(av[4], 0));
+#endif
+#ifdef POSIX_FADV_DONTNEED
+	if (advice && posix_fadvise(fd, 0, 0, advice) != 0)
+		fprintf(stderr, "%s: posix_fadvise failed\n", av[0]);
+#endif
 
 	/* Get the number of iterations */
 	if (niter == 0) {
@@ -95,6 +263,31 @@ main(ac, av)
 		return (0);
 	}
 
+	/* Make up the random order: every block of a region once */
+	if ((nblocks = bytes / bufsize / nthreads) == 0) {
+		fprintf(stderr, "%s: size to read is less than one block "
+			"per thread\n", av[0]);
+		exit(1);
+	}
+	if (randomize) {
+		if ((order = (unsigned int *)malloc(nblocks *
+		    sizeof(unsigned int))) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		for (i = 0; i < nblocks; i++)
+			order[i] = i;
+		srandom(nblocks);
+		for (i = nblocks - 1; i > 0; i--) {
+			j = random() % (i + 1);
+			tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+	}
+	for (i = 0; i < nthreads; i++)
+		reader_init(&readers[i]);
+
 	/* initialize timing module (calculates timing overhead, etc) */
 	init_timing();
 
@@ -102,14 +295,49 @@ main(ac, av)
 	 * Take the real data
 	 */
 #ifndef COLD_CACHE
-	do_fileread(1, &totaltime);	/* prime the cache */
+	if (!drop_cache)
+		do_fileread(1, &totaltime);	/* prime the cache */
 #endif
-	do_fileread(1, &totaltime);	/* get cached reread */
-	output_bandwidth(bytes, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_fileread(1, &totaltime);	/* get cached reread */
+		if (threaded)
+			output_thread_bandwidth((double)nblocks * bufsize,
+						totaltime);
+		else
+			output_bandwidth(bytes, totaltime);
+	}
+	repeat_done();
 
 	return (0);
 }
 
+#define	SIXTEEN	sum += p[0]+p[1]+p[2]+p[3]+p[4]+p[5]+p[6]+p[7]+p[8]+p[9]+ \
+		p[10]+p[11]+p[12]+p[13]+p[14]+p[15]; p += 16;
+#define	SIXTYFOUR	SIXTEEN SIXTEEN SIXTEEN SIXTEEN
+
+/*
+ * Sum a buffer of bufsize bytes, so that the data read is used
+ */
+unsigned int
+sumbuf(buf)
+	char *buf;
+{
+	register unsigned int sum = 0, *p;
+	unsigned int j;
+
+	for (p=(unsigned int*)buf, j=bufsize/1024; j > 0; j--) {
+		/*
+		 * This assumes that sizeof(int) == 4
+		 */
+		SIXTYFOUR
+		SIXTYFOUR
+		SIXTYFOUR
+		SIXTYFOUR	/* 256 * 4 = 1K; * 64 in loop = 64K */
+	}
+	return (sum);
+}
+
 /*
  * This function does all the work. It reads "bytes" from "fd" "num_iter"
  * times and reports the total time in whatever unit our clock is using.
@@ -129,49 +357,136 @@ do_fileread(num_iter, t)
 	 * unsigned int bufsize;
 	 * int fd;
 	 */
-	register unsigned int sum, *p;
-	unsigned int j, size;
-	int n;
-	char *buf = (char *) malloc(bufsize);
+	unsigned int sum;
 
-	if (!buf) {
-		perror("malloc");
-		exit(1);
+	if (drop_cache) {
+#ifdef POSIX_FADV_DONTNEED
+		/* Dirty pages would stay behind */
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	}
+	if (threaded) {
+		thread_run(&fileread_thread, num_iter, t);
+		return (0);
 	}
-	bzero(buf, bufsize);
 
 	/* We first rewind the file */
 	lseek(fd, 0, SEEK_SET);
 
-#define	SIXTEEN	sum += p[0]+p[1]+p[2]+p[3]+p[4]+p[5]+p[6]+p[7]+p[8]+p[9]+ \
-		p[10]+p[11]+p[12]+p[13]+p[14]+p[15]; p += 16;
-#define	SIXTYFOUR	SIXTEEN SIXTEEN SIXTEEN SIXTEEN
+	start();		/* start the clocks */
+	sum = read_blocks(&readers[0], 0,
+			  (bytes * num_iter + bufsize - 1) / bufsize);
+	*t = stop(sum);		/* stop the clocks, return the value */
 
-	/*
-	 * Now we do the real work
-	 */
-	sum = 0;
-	size = bytes * num_iter;
+	return (0);		/* success */
+}
 
-	start();		/* start the clocks */
-	while (size > 0) {
-		CHK(n = read(fd, buf, bufsize));
-		if (n < bufsize) {
-			break;
+/*
+ * Thread worker for -t: thread id reads region id of the file
+ */
+void
+fileread_thread(int id, int num_iter)
+{
+	thread_begin(id);
+	read_blocks(&readers[id], id * nblocks, nblocks * num_iter);
+	thread_end(id);
+}
+
+#ifdef HAVE_URING
+/*
+ * read_blocks() through r's ring: keep uring_depth reads in flight,
+ * summing each buffer as its read completes and then reusing it for the
+ * next.
+ */
+unsigned int
+uring_blocks(r, first, nreq)
+	struct reader *r;
+	unsigned int first, nreq;
+{
+	unsigned long long	data, off;
+	unsigned int		sum = 0, next = 0;
+	int			slot, res, inflight = 0, nfree;
+
+	for (nfree = 0; nfree < uring_depth; nfree++)
+		r->freeslots[nfree] = nfree;
+
+	for (;;) {
+		while (inflight < uring_depth && next < nreq) {
+			slot = r->freeslots[--nfree];
+			off = first + (randomize ? order[next % nblocks] :
+				       next);
+			if (sample_batch)
+				r->stamps[slot] = read_clock();
+			uring_prep(&r->ring, IORING_OP_READ,
+				   (uring_flags & URING_FILE) ? 0 : fd,
+				   r->bufs + slot * bufsize, bufsize,
+				   off * bufsize, slot, slot);
+			inflight++;
+			next++;
 		}
-		for (p=(unsigned int*)buf, j=bufsize/1024; j > 0; j--) {
-			/*
-			 * This assumes that sizeof(int) == 4
-			 */
-			SIXTYFOUR
-			SIXTYFOUR
-			SIXTYFOUR
-			SIXTYFOUR	/* 256 * 4 = 1K; * 64 in loop = 64K */
+		if (inflight == 0)
+			break;
+		CHK(uring_submit(&r->ring, 1));
+		while (uring_reap(&r->ring, &data, &res)) {
+			slot = (int)data;
+			inflight--;
+			if (res < 0) {
+				errno = -res;
+				perror("read");
+				exit(1);
+			}
+			if (sample_batch)
+				latency_hist_add(read_clock() -
+						 r->stamps[slot]);
+			if (res < bufsize)
+				nreq = next;	/* end of file */
+			else
+				sum += sumbuf(r->bufs + slot * bufsize);
+			r->freeslots[nfree++] = slot;
 		}
-		size -= n;
 	}
-	*t = stop(sum);		/* stop the clocks, return the value */
+	return (sum);
+}
+#endif /* HAVE_URING */
 
-	free(buf);
-	return (0);		/* success */
+/*
+ * Read and sum nreq blocks for reader r, starting from block first (in
+ * random order with -R), stopping early at end of file. The single
+ * sequential reader uses read() from the current offset, as this
+ * benchmark always has; everyone else uses pread().
+ */
+unsigned int
+read_blocks(r, first, nreq)
+	struct reader *r;
+	unsigned int first, nreq;
+{
+	unsigned int sum = 0, k;
+	int n;
+	clk_t t0;
+
+#ifdef HAVE_URING
+	if (uring_depth)
+		return (uring_blocks(r, first, nreq));
+#endif
+	for (k = 0; k < nreq; k++) {
+		if (sample_batch)
+			t0 = read_clock();
+		if (randomize) {
+			CHK(n = pread(fd, r->buf, bufsize, (off_t)bufsize *
+				      (first + order[k % nblocks])));
+		} else if (threaded) {
+			CHK(n = pread(fd, r->buf, bufsize, (off_t)bufsize *
+				      (first + k % nblocks)));
+		} else {
+			CHK(n = read(fd, r->buf, bufsize));
+		}
+		if (sample_batch)
+			latency_hist_add(read_clock() - t0);
+		if (n < bufsize) {
+			break;
+		}
+		sum += sumbuf(r->buf);
+	}
+	return (sum);
 }
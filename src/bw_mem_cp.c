@@ -27,7 +27,7 @@
 /*
  * bw_mem_cp.c - measures copy bandwidth delivered by the memory system
  *
- * Usage: bw_mem_cp size libc|unrolled aligned|unaligned
+ * Usage: bw_mem_cp size libc|unrolled|<kernel> aligned|unaligned
  *
  * Measures both unrolled (simplistic) and library (general) copy
  * times of aligned & unaligned data.  Aligned here means that the
@@ -35,6 +35,8 @@
  * the pointers are word aligned.
  * The copy does *not* include the cost of an add, and thus may not be
  * directly comparable to the memory read and write bandwidth routines.
+ * The vector, rep movsb and non-temporal kernels of lib_memkern.c can
+ * be selected by name in place of libc or unrolled.
  *
  * Based on:
  *	$lmbenchId: bw_mem_cp.c,v 1.2 1995/03/11 02:19:56 lm Exp $
@@ -44,13 +46,17 @@
 char	*id = "$Id: bw_mem_cp.c,v 1.7 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include "common.c"
+#include "lib_thread.c"
+#include "lib_numa.c"
+#include "lib_memkern.c"
 
 /*
  * Not all machines have spiffy 64-bit operations (notably the Intel x86's).
  * On the x86, gcc generates slower code with 64-bit copies than with 
  * 32-bit copies (due to data dependencies in the pipeline), so we use 32-bit 
  * ints instead of doubles. Using ints also should allow us to use the 
- * optimal/native word size
+ * optimal/native word size. Wider transfers are available through the
+ * kernels in lib_memkern.c.
  */
 #ifndef TYPE
 #define TYPE	unsigned int
@@ -69,6 +75,7 @@ int 	do_copy(int num_iter, clk_t *time);
  */
 unsigned int 	bytes;		/* the number of bytes to be read */
 int		libc;		/* 1 if libc bcopy (i.e. not unrolled) */
+struct memkern	*kern;		/* vector kernel, or NULL */
 int		aligned;	/* 1 if aligned */
 
 void	unrolled();
@@ -78,15 +85,19 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 	unsigned int	xferred;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 5) {
-		fprintf(stderr, "Usage: %s%s iterations size libc|unrolled aligned|unaligned\n", 
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_numa_args(&ac, &av) || parse_thread_args(&ac, &av) ||
+	    ac != 5) {
+		fprintf(stderr, "Usage: %s%s%s%s%s iterations size libc|unrolled|sse2|avx2|avx512|movsb|nt aligned|unaligned\n", 
+			av[0], counter_argstring, repeat_argstring,
+			numa_argstring, thread_argstring);
 		exit(1);
 	}
 	
@@ -97,6 +108,13 @@ main(ac, av)
 		libc = 1;
 	else
 		libc = 0;
+	if (!libc && strcmp(av[3], "unrolled") != 0) {
+		kern = memkern_lookup(av[3], MEMKERN_COPY);
+		if (!kern) {
+			printf("<error>\n");
+			exit(1);
+		}
+	}
 	if (strcmp(av[4], "aligned") != 0)
 		aligned = 0;
 	else
@@ -108,6 +126,8 @@ main(ac, av)
 	 */
 	if (libc)
 		xferred = bytes;
+	else if (kern)
+		xferred = memkern_bytes(bytes);
 	else
 		xferred = (16*SIZE) * (bytes / (16 * SIZE));
 	if (xferred == 0) {
@@ -140,33 +160,27 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_copy(niter, &totaltime);	/* get cached copy */
-
-	output_bandwidth(niter * xferred, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_copy(niter, &totaltime);	/* get cached copy */
+		if (threaded)
+			output_thread_bandwidth((double)niter * xferred,
+						totaltime);
+		else
+			output_bandwidth((double)niter * xferred, totaltime);
+	}
+	repeat_done();
 	
 	return (0);
 }
 
 /*
- * This function does all the work. It mallocs two buffers of the appropriate
- * size and repeatedly copies one to the other, timing the entire operation.
- *
- * Returns 0 if the benchmark was successful, and -1 if there were too many
- * iterations.
+ * Allocate and touch the source and destination buffers; returns the
+ * pointer to pass to free().
  */
-int
-do_copy(num_iter, t)
-	int num_iter;
-	clk_t *t;
+TYPE *
+alloc_bufs(srcp, dstp)
+	TYPE **srcp, **dstp;
 {
-	/*
-	 * 	Global parameters 
-	 *
-	 * unsigned int bytes;
-	 * int 		aligned;
-	 * int		libc;
-	 */
-        int     i;
         TYPE   *src, *dst, *savsrc;
 	unsigned long tmp;
 
@@ -177,6 +191,7 @@ do_copy(num_iter, t)
 		perror("malloc");
 		exit(1);
 	}
+	numa_bind_mem(src, 2*(bytes + 16384));
 
 	/*
 	 * Page-align the two regions (assumes <=8K pagesize)
@@ -197,21 +212,89 @@ do_copy(num_iter, t)
 	bzero(src, bytes);
 	bzero(dst, bytes);
 #endif
+	numa_check(src, "source buffer");
+	numa_check(dst, "destination buffer");
+
+	*srcp = src;
+	*dstp = dst;
+	return (savsrc);
+}
+
+/*
+ * Copy src to dst num_iter times.
+ */
+void
+copy_loop(num_iter, src, dst)
+	int num_iter;
+	TYPE *src, *dst;
+{
+        int     i;
 
-	/* Do the copy measurement: copy num_iter times and time */
 	if (libc) {
-		start();
 		for (i = num_iter; i > 0; i--) {
 			bcopy(src, dst, bytes);
 		}
-		*t = stop(dst);
+	} else if (kern) {
+		for (i = num_iter; i > 0; i--) {
+			(*kern->cp)(dst, src, memkern_bytes(bytes));
+		}
 	} else {
-		start();
 		for (i = num_iter; i > 0; i--) {
 			unrolled(src, dst, bytes);
 		}
-		*t = stop(dst);
 	}
+}
+
+/*
+ * Thread worker for -t: each thread copies between its own pair of
+ * buffers, touched first by the thread that uses them.
+ */
+void
+copy_thread(int id, int num_iter)
+{
+        TYPE   *src, *dst, *savsrc;
+
+	savsrc = alloc_bufs(&src, &dst);
+
+	thread_begin(id);
+	copy_loop(num_iter, src, dst);
+	thread_end(id);
+
+	free(savsrc);
+}
+
+/*
+ * This function does all the work. It mallocs two buffers of the appropriate
+ * size and repeatedly copies one to the other, timing the entire operation.
+ *
+ * Returns 0 if the benchmark was successful, and -1 if there were too many
+ * iterations.
+ */
+int
+do_copy(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	/*
+	 * 	Global parameters 
+	 *
+	 * unsigned int bytes;
+	 * int 		aligned;
+	 * int		libc;
+	 */
+        TYPE   *src, *dst, *savsrc;
+
+	if (threaded) {
+		thread_run(&copy_thread, num_iter, t);
+		return (0);
+	}
+
+	savsrc = alloc_bufs(&src, &dst);
+
+	/* Do the copy measurement: copy num_iter times and time */
+	start();
+	copy_loop(num_iter, src, dst);
+	*t = stop(dst);
 	
 	/* Release allocated memory */
 	free(savsrc);
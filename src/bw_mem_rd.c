@@ -38,10 +38,14 @@
 char	*id = "$Id: bw_mem_rd.c,v 1.6 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include "common.c"
+#include "lib_thread.c"
+#include "lib_memkern.c"
+#include "lib_pagealloc.c"
 
 /*
  * Use unsigned int: supposedly the "optimal" transfer size for a given
- * architecture.
+ * architecture. Wider transfers are available through the kernels in
+ * lib_memkern.c.
  */
 #ifndef TYPE
 #define TYPE    unsigned int
@@ -59,6 +63,7 @@ int 	do_memread(int num_iter, clk_t *time);
  * lists and the gen_iterations function
  */
 unsigned int 	bytes;		/* the number of bytes to be read */
+struct memkern	*kern;		/* vector kernel, or NULL if unrolled */
 
 int
 main(ac, av)
@@ -66,15 +71,20 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 	unsigned int	xferred;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations size\n", av[0],
-			counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_page_args(&ac, &av) || parse_thread_args(&ac, &av) ||
+	    ac < 3 || ac > 4) {
+		fprintf(stderr, "Usage: %s%s%s%s%s iterations size "
+			"[unrolled|sse2|avx2|avx512]\n", av[0],
+			counter_argstring, repeat_argstring, page_argstring,
+			thread_argstring);
 		exit(1);
 	}
 
@@ -82,11 +92,22 @@ main(ac, av)
 	niter = atoi(av[1]);
 	bytes = parse_bytes(av[2]);
 
+	if (ac == 4 && strcmp(av[3], "unrolled") != 0) {
+		kern = memkern_lookup(av[3], MEMKERN_READ);
+		if (!kern) {
+			printf("<error>\n");
+			exit(1);
+		}
+	}
+
 	/*
 	 * The gory calculation on the next line computes the actual number of
 	 * bytes tranferred by the unrolled loop.
 	 */
-	xferred = (200*SIZE)*((((bytes/SIZE)-200)+199)/200);
+	if (kern)
+		xferred = memkern_bytes(bytes);
+	else
+		xferred = (200*SIZE)*((((bytes/SIZE)-200)+199)/200);
 	if (xferred == 0) {
 		fprintf(stderr, "error: buffer size too small: must be at "
 			"least %d bytes.\n",201*SIZE);
@@ -118,9 +139,15 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_memread(niter, &totaltime);	/* get cached reread */
-
-	output_bandwidth(niter * xferred, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_memread(niter, &totaltime);	/* get cached reread */
+		if (threaded)
+			output_thread_bandwidth((double)niter * xferred,
+						totaltime);
+		else
+			output_bandwidth((double)niter * xferred, totaltime);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -138,6 +165,12 @@ do_loop(int num_iter, TYPE *mem, TYPE *end_in)
 
 	acc = 0;
 
+	if (kern) {
+		for (int i = num_iter; i > 0; i--)
+			acc += (*kern->rd)(mem, memkern_bytes(bytes));
+		return;
+	}
+
 	/* Read num_iter times */
 	for (int i = num_iter; i > 0; i--) {
 		for (TYPE *p = mem; p < end; ) {
@@ -147,6 +180,32 @@ do_loop(int num_iter, TYPE *mem, TYPE *end_in)
 	}
 }
 
+/*
+ * Thread worker for -t: each thread reads its own page-aligned buffer of
+ * "bytes" bytes. The buffer is touched by the thread that uses it so that
+ * its pages are allocated near that thread's CPU.
+ */
+void
+memread_thread(int id, int num_iter)
+{
+	TYPE *mem;
+
+	mem = (TYPE *)page_alloc(bytes + 16384);
+	if (!mem) {
+		perror("page_alloc");
+		exit(1);
+	}
+#ifndef COLD_CACHE
+	bzero(mem, bytes);	/* Touch all of the pages */
+#endif
+
+	thread_begin(id);
+	do_loop(num_iter, mem, mem + (bytes/SIZE) - 200);
+	thread_end(id);
+
+	page_free(mem, bytes + 16384);
+}
+
 /*
  * This function does all the work. It mallocs a buffer of size "bytes" and
  * then reads that buffer num_iter times, timing the entire operation.
@@ -167,11 +226,16 @@ do_memread(num_iter, t)
 	TYPE *end;
         TYPE *mem;
 
+	if (threaded) {
+		thread_run(&memread_thread, num_iter, t);
+		return (0);
+	}
+
 	/* Allocate the buffer to be used for reading */
-        mem = (TYPE *)malloc(bytes + 16384);
+        mem = (TYPE *)page_alloc(bytes + 16384);
 
 	if (!mem) {
-		perror("malloc");
+		perror("page_alloc");
 		exit(1);
 	}
 #ifndef COLD_CACHE
@@ -187,7 +251,7 @@ do_memread(num_iter, t)
 
 	*t = stop(NULL);	/* stop timing and record result */
 
-	free(mem);		/* free memory allocated */
+	page_free(mem, bytes + 16384);	/* free memory allocated */
 
 	return (0);		/* success */
 }
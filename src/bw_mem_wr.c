@@ -39,10 +39,13 @@
 char	*id = "$Id: bw_mem_wr.c,v 1.6 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include "common.c"
+#include "lib_thread.c"
+#include "lib_memkern.c"
 
 /*
- * Use unsigned int: supposedly the "optimal" transfer size for a given 
- * architecture.
+ * Use unsigned int: supposedly the "optimal" transfer size for a given
+ * architecture. Wider transfers are available through the kernels in
+ * lib_memkern.c.
  */
 #ifndef TYPE
 #define TYPE    unsigned int
@@ -60,6 +63,7 @@ int 	do_memwrite(int num_iter, clk_t *time);
  * lists and the gen_iterations function 
  */
 unsigned int 	bytes;		/* the number of bytes to be written */
+struct memkern	*kern;		/* vector kernel, or NULL if unrolled */
 
 int
 main(ac, av)
@@ -67,15 +71,18 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 	unsigned int	xferred;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations size\n", av[0],
-			counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_thread_args(&ac, &av) || ac < 3 || ac > 4) {
+		fprintf(stderr, "Usage: %s%s%s%s iterations size "
+			"[unrolled|sse2|avx2|avx512|movsb|nt]\n", av[0],
+			counter_argstring, repeat_argstring, thread_argstring);
 		exit(1);
 	}
 	
@@ -83,11 +90,22 @@ main(ac, av)
 	niter = atoi(av[1]);
 	bytes = parse_bytes(av[2]);
 	
+	if (ac == 4 && strcmp(av[3], "unrolled") != 0) {
+		kern = memkern_lookup(av[3], MEMKERN_WRITE);
+		if (!kern) {
+			printf("<error>\n");
+			exit(1);
+		}
+	}
+
 	/*
 	 * The gory calculation on the next line computes the actual number of
 	 * bytes tranferred by the unrolled loop.
 	 */
-	xferred = (200*SIZE)*((((bytes/SIZE)-200)+199)/200);
+	if (kern)
+		xferred = memkern_bytes(bytes);
+	else
+		xferred = (200*SIZE)*((((bytes/SIZE)-200)+199)/200);
 	if (xferred == 0) {
 		fprintf(stderr, "error: buffer size too small: must be at "
 			"least %d bytes.\n",201*SIZE);
@@ -119,13 +137,71 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_memwrite(niter, &totaltime);	/* get cached write bandwidth */
-
-	output_bandwidth(niter * xferred, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_memwrite(niter, &totaltime);	/* get cached write bandwidth */
+		if (threaded)
+			output_thread_bandwidth((double)niter * xferred,
+						totaltime);
+		else
+			output_bandwidth((double)niter * xferred, totaltime);
+	}
+	repeat_done();
 	
 	return (0);
 }
 
+void
+do_loop(int num_iter, TYPE *mem, TYPE *end_in)
+{
+	register TYPE *p;
+	register TYPE *end = end_in;
+	int i;
+
+#define	TWENTY	p[0]=1;p[1]=1;p[2]=1;p[3]=1;p[4]=1;p[5]=1;p[6]=1;p[7]=1;\
+		p[8]=1;p[9]=1;p[10]=1;p[11]=1;p[12]=1;p[13]=1;p[14]=1;p[15]=1;\
+		p[16]=1;p[17]=1;p[18]=1;p[19]=1;p+=20;
+#define	HUNDRED	TWENTY TWENTY TWENTY TWENTY TWENTY
+
+	if (kern) {
+		for (i = num_iter; i > 0; i--)
+			(*kern->wr)(mem, memkern_bytes(bytes));
+		return;
+	}
+
+	/* Write num_iter times */
+	for (i = num_iter; i > 0; i--) {
+		for (p = mem; p < end; ) {
+			HUNDRED
+			HUNDRED
+		}
+	}
+}
+
+/*
+ * Thread worker for -t: each thread writes its own page-aligned buffer of
+ * "bytes" bytes, touched first by the thread that uses it.
+ */
+void
+memwrite_thread(int id, int num_iter)
+{
+	TYPE *mem;
+
+	mem = (TYPE *)valloc(bytes + 16384);
+	if (!mem) {
+		perror("valloc");
+		exit(1);
+	}
+#ifndef COLD_CACHE
+	bzero(mem, bytes);	/* Touch all of the pages */
+#endif
+
+	thread_begin(id);
+	do_loop(num_iter, mem, mem + (bytes/SIZE) - 200);
+	thread_end(id);
+
+	free(mem);
+}
+
 /*
  * This function does all the work. It mallocs a buffer of size "bytes" and
  * then writes that buffer num_iter times, timing the entire operation.
@@ -143,12 +219,14 @@ do_memwrite(num_iter, t)
 	 *
 	 * unsigned int bytes;
 	 */
-	register TYPE *p;
-	register unsigned long acc;
 	register TYPE *end;
-        int i;
         TYPE   *mem;
 
+	if (threaded) {
+		thread_run(&memwrite_thread, num_iter, t);
+		return (0);
+	}
+
 	/* Allocate the buffer to be used for writeing */
         mem = (TYPE *)malloc(bytes + 16384);
 
@@ -160,27 +238,14 @@ do_memwrite(num_iter, t)
 	bzero(mem, bytes);	/* Touch all of the pages */
 #endif
 
-#define	TWENTY	p[0]=1;p[1]=1;p[2]=1;p[3]=1;p[4]=1;p[5]=1;p[6]=1;p[7]=1;\
-		p[8]=1;p[9]=1;p[10]=1;p[11]=1;p[12]=1;p[13]=1;p[14]=1;p[15]=1;\
-		p[16]=1;p[17]=1;p[18]=1;p[19]=1;p+=20;
-#define	HUNDRED	TWENTY TWENTY TWENTY TWENTY TWENTY
-
-	acc = 0;
-
 	end = mem + (bytes/SIZE) - 200;
 
 	/* Start timing */
 	start();
 
-	/* Write num_iter times */
-	for (i = num_iter; i > 0; i--) {
-		for (p = mem; p < end; ) {
-			HUNDRED
-			HUNDRED
-		}
-	}
+	do_loop(num_iter, mem, end);
 
-	*t = stop(acc);		/* stop timing and record result */
+	*t = stop(NULL);	/* stop timing and record result */
 
 	free(mem);		/* free memory allocated */
 
@@ -47,6 +47,7 @@
 char	*id = "$Id: bw_mmap_rd.c,v 1.8 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include "common.c"
+#include "lib_pagealloc.c"
 
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -85,6 +86,7 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int 	xferred;
 	struct stat 	sbuf;
 	int		niter;
@@ -93,9 +95,11 @@ main(ac, av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 4) {
-		fprintf(stderr, "Usage: %s%s ignored size file\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_page_args(&ac, &av) || ac != 4) {
+		fprintf(stderr, "Usage: %s%s%s%s ignored size file\n",
+			av[0], counter_argstring, repeat_argstring,
+			page_argstring);
 		exit(1);
 	}
 
@@ -138,9 +142,11 @@ main(ac, av)
 #ifndef COLD_CACHE
 	do_mmapread(1, &totaltime);	/* prime the cache */
 #endif
-	do_mmapread(1, &totaltime);	/* get cached reread */
-
-	output_bandwidth(xferred, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_mmapread(1, &totaltime);	/* get cached reread */
+		output_bandwidth(xferred, totaltime);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -200,6 +206,7 @@ do_mmapread(num_iter, t)
 		CHK(where = (TYPE *)mmap(0, bytes, PROT_READ, MAP_SHARED,
 					 fd, 0));
 #endif
+		page_advise(where, bytes);
 		start();
 		for (p = where; p < end; ) {
 			HUNDRED
@@ -27,7 +27,20 @@
 /*
  * bw_pipe.c - pipe bandwidth benchmark.
  *
- * Usage: bw_pipe transfersize
+ * Usage: bw_pipe iterations transfersize [mode [pipesize]]
+ *
+ * mode selects how the data gets into and out of the pipe:
+ *
+ *	copy	 write() and read(), each of which copies the data (default)
+ *	splice	 write(), then splice() from the pipe to /dev/null, so only
+ *		 the writer copies
+ *	vmsplice vmsplice() the writer's pages into the pipe, then splice()
+ *		 them to /dev/null; nothing is copied
+ *	tee	 write(), then tee() the pipe into a second pipe and splice()
+ *		 both to /dev/null
+ *
+ * All but copy are Linux-only. If pipesize is given, the capacity of the
+ * pipe(s) is set to it with F_SETPIPE_SZ.
  *
  * Based on:
  *	$lmbenchId: bw_pipe.c,v 1.1 1994/11/18 08:49:48 lm Exp $
@@ -37,6 +50,10 @@
 char	*id = "$Id: bw_pipe.c,v 1.4 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include <sys/wait.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
 
 #include "common.c"
 
@@ -52,6 +69,13 @@ int 	do_pipexfer(int num_iter, clk_t *time);
  * lists and the gen_iterations function
  */
 unsigned int 	bufsize;	/* the size of the request buffer */
+int		mode;		/* XFER_* */
+int		pipesize;	/* pipe capacity, or 0 for the default */
+
+#define XFER_COPY	0
+#define XFER_SPLICE	1
+#define XFER_VMSPLICE	2
+#define XFER_TEE	3
 
 /* Default transfer: 4MB. Thus even on fast machines we bypass caches */
 #define XFERUNIT	(4*1024*1024)
@@ -63,20 +87,46 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations transfersize\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac < 3 || ac > 5) {
+		fprintf(stderr, "Usage: %s%s%s iterations transfersize "
+			"[copy|splice|vmsplice|tee [pipesize]]\n",
+			av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
 	/* parse command line parameters */
 	niter = atoi(av[1]);
 	bufsize = parse_bytes(av[2]);
+	if (ac < 4 || !strcmp(av[3], "copy"))
+		mode = XFER_COPY;
+#ifdef SPLICE_F_MOVE
+	else if (!strcmp(av[3], "splice"))
+		mode = XFER_SPLICE;
+	else if (!strcmp(av[3], "vmsplice"))
+		mode = XFER_VMSPLICE;
+	else if (!strcmp(av[3], "tee"))
+		mode = XFER_TEE;
+#endif
+	else {
+		fprintf(stderr, "%s: unknown or unsupported mode %s\n",
+			av[0], av[3]);
+		exit(1);
+	}
+	if (ac == 5) {
+		pipesize = parse_bytes(av[4]);
+#ifndef F_SETPIPE_SZ
+		fprintf(stderr, "%s: cannot set the pipe size on this system\n",
+			av[0]);
+		exit(1);
+#endif
+	}
 
 	/* initialize timing module (calculates timing overhead, etc) */
 	init_timing();
@@ -102,13 +152,53 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_pipexfer(niter, &totaltime);	/* get pipe bandwidth */
-
-	output_bandwidth(niter * XFERUNIT, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_pipexfer(niter, &totaltime);	/* get pipe bandwidth */
+		output_bandwidth((double)niter * XFERUNIT, totaltime);
+	}
+	repeat_done();
 
 	return (0);
 }
 
+/*
+ * Make a pipe, with the requested capacity
+ */
+void
+make_pipe(p)
+	int p[2];
+{
+	if (pipe(p) == -1) {
+		perror("pipe");
+		exit(1);
+	}
+#ifdef F_SETPIPE_SZ
+	if (pipesize && fcntl(p[1], F_SETPIPE_SZ, pipesize) == -1) {
+		perror("F_SETPIPE_SZ");
+		exit(1);
+	}
+#endif
+}
+
+#ifdef SPLICE_F_MOVE
+/*
+ * Move exactly n bytes from pipe fd to /dev/null; used for the second
+ * half of a tee. Returns n, or whatever splice() returned if it failed.
+ */
+int
+splice_all(fd, devnull, n)
+	int fd, devnull, n;
+{
+	int	m, left;
+
+	for (left = n; left > 0; left -= m)
+		if ((m = splice(fd, NULL, devnull, NULL, left,
+				SPLICE_F_MOVE)) <= 0)
+			return (m);
+	return (n);
+}
+#endif
+
 /*
  * This function does all the work. It transfers XFERUNIT through the pipe
  * num_iter times, timing the entire operation.
@@ -124,19 +214,22 @@ do_pipexfer(num_iter, t)
 	 * 	Global parameters
 	 *
 	 * unsigned int bufsize;
+	 * int mode, pipesize;
 	 */
 	int		pipes[2];
-	unsigned int	todo, n, done = 0;
+	unsigned long long todo, done = 0;	/* 4GB overflows 32 bits */
+	int		n;
 	char 		*buf;
 	int		termstat;
+#ifdef SPLICE_F_MOVE
+	int		devnull = -1, teepipe[2];
+	struct iovec	iov;
+#endif
 
-	if (pipe(pipes) == -1) {
-		perror("pipe");
-		exit(1);
-	}
+	make_pipe(pipes);
 
 	/* Amount to transfer */
-	todo = XFERUNIT * num_iter;
+	todo = (unsigned long long)XFERUNIT * num_iter;
 
 	/* Allocate buffer */
 	buf = (char *) malloc(bufsize);
@@ -146,9 +239,34 @@ do_pipexfer(num_iter, t)
 		/* NOTREACHED */
 	}
 
+#ifdef SPLICE_F_MOVE
+	if (mode != XFER_COPY &&
+	    (devnull = open("/dev/null", O_WRONLY)) == -1) {
+		perror("/dev/null");
+		exit(1);
+	}
+	if (mode == XFER_TEE)
+		make_pipe(teepipe);
+	iov.iov_base = buf;
+	iov.iov_len = bufsize;
+#endif
+
 	/* Spawn off a writer, then time the read */
 	switch (fork()) {
 	case 0:			/* writer */
+#ifdef SPLICE_F_MOVE
+		if (mode == XFER_VMSPLICE) {
+			/*
+			 * The same pages go in again and again; the reader
+			 * never looks at them, so it doesn't matter that they
+			 * may still be in the pipe when they are reused.
+			 */
+			while ((done < todo) &&
+			       ((n = vmsplice(pipes[1], &iov, 1, 0)) > 0))
+				done += n;
+			exit(0);
+		}
+#endif
 		while ((done < todo) &&
 		       ((n = write(pipes[1], buf, bufsize)) > 0))
 			done += n;
@@ -165,14 +283,52 @@ do_pipexfer(num_iter, t)
 		sleep(1);
 
 		start();	/* start timing */
-		while ((done < todo) &&
-		       ((n = read(pipes[0], buf, bufsize)) > 0))
-			done += n;
+		switch (mode) {
+		case XFER_COPY:
+			while ((done < todo) &&
+			       ((n = read(pipes[0], buf, bufsize)) > 0))
+				done += n;
+			break;
+#ifdef SPLICE_F_MOVE
+		case XFER_SPLICE:
+		case XFER_VMSPLICE:
+			while ((done < todo) &&
+			       ((n = splice(pipes[0], NULL, devnull, NULL,
+					    bufsize, SPLICE_F_MOVE)) > 0))
+				done += n;
+			break;
+		case XFER_TEE:
+			/*
+			 * tee() only references the pages, so the original
+			 * must be drained as well as the copy.
+			 */
+			while ((done < todo) &&
+			       ((n = tee(pipes[0], teepipe[1], bufsize, 0)) > 0) &&
+			       splice_all(pipes[0], devnull, n) == n &&
+			       splice_all(teepipe[0], devnull, n) == n)
+				done += n;
+			break;
+#endif
+		}
 		*t = stop(NULL);	/* stop timing */
+		if (done < todo) {
+			perror("bw_pipe: transfer");
+			exit(1);
+		}
 
 		wait(&termstat); /* wait for writer to exit */
 	}
 
+	close(pipes[0]);
+	close(pipes[1]);
+#ifdef SPLICE_F_MOVE
+	if (mode == XFER_TEE) {
+		close(teepipe[0]);
+		close(teepipe[1]);
+	}
+	if (devnull != -1)
+		close(devnull);
+#endif
 	free(buf);		/* release memory */
 
 	return (0);
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * bw_shm.c - shared memory IPC bandwidth benchmark
+ *
+ * Usage: bw_shm [-P policy] iterations transfersize memfd|posix|sysv
+ *		pipe|eventfd|futex|sem stream|handoff
+ *
+ * A producer process copies transfersize-byte messages into slots of a
+ * shared mapping and a consumer copies them out again, so, as in
+ * bw_pipe, each byte is copied twice; but the kernel only gets involved
+ * when one side has to sleep. The mapping is made with
+ *
+ *	memfd	memfd_create() (Linux)
+ *	posix	shm_open(), unlinked at once
+ *	sysv	shmget(), removed at once
+ *
+ * and -P 2m or 1g puts it on explicit huge pages (memfd and sysv only),
+ * -P thp asks for transparent ones. A side that finds the ring full or
+ * empty sleeps on a lib_wake.c slot, and the other side posts to it only
+ * if it is asleep.
+ *
+ * In "stream" mode there are SHM_SLOTS slots and the result is the
+ * bandwidth, to compare with bw_pipe at the same transfer size. In
+ * "handoff" mode there is one slot, so the producer waits for each
+ * message to be taken before it sends the next; the result is the
+ * latency of one message: copy in, wake, copy out, wake back.
+ */
+char	*id = "$Id$\n";
+
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <fcntl.h>
+
+#include "common.c"
+#include "lib_pagealloc.c"
+#include "lib_wake.c"
+
+#define SHM_MEMFD	0
+#define SHM_POSIX	1
+#define SHM_SYSV	2
+
+#define SHM_SLOTS	4
+
+/* Default transfer per iteration in stream mode: 4MB, as for bw_pipe */
+#define XFERUNIT	(4*1024*1024)
+
+/*
+ * The ring's control block, in a shared anonymous mapping of its own.
+ * head and tail count the messages put in and taken out.
+ */
+struct shm_ctl {
+	struct wake_slot	data;		/* consumer sleeps here */
+	struct wake_slot	space;		/* producer sleeps here */
+	volatile unsigned long	head;
+	char			pad1[64];
+	volatile unsigned long	tail;
+	char			pad2[64];
+	volatile int		data_waiting;
+	volatile int		space_waiting;
+};
+
+/* The worker function */
+int 	do_shmxfer(int num_iter, clk_t *time);
+char	*shm_create();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+unsigned int 	bufsize;	/* message size */
+int		nslots;		/* SHM_SLOTS, or 1 for handoff */
+int		msgs_per_iter;	/* messages per iteration */
+struct shm_ctl	*ctl;		/* the control block */
+char		*ring;		/* the slots */
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	unsigned int	niter;
+	clk_t		totaltime;
+	int		run, type;
+	unsigned long	len;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || parse_page_args(&ac, &av) ||
+	    ac != 6) {
+		fprintf(stderr, "Usage: %s%s%s%s%s iterations transfersize "
+			"memfd|posix|sysv %s stream|handoff\n", av[0],
+			counter_argstring, repeat_argstring, sample_argstring,
+			page_argstring, wake_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	bufsize = parse_bytes(av[2]);
+	if (!strcmp(av[3], "memfd"))
+		type = SHM_MEMFD;
+	else if (!strcmp(av[3], "posix"))
+		type = SHM_POSIX;
+	else if (!strcmp(av[3], "sysv"))
+		type = SHM_SYSV;
+	else {
+		fprintf(stderr, "%s: unknown shared memory type %s\n",
+			av[0], av[3]);
+		exit(1);
+	}
+	if (parse_wake_mech(av[4])) {
+		fprintf(stderr, "%s: unknown or unsupported mechanism %s\n",
+			av[0], av[4]);
+		exit(1);
+	}
+	if (!strcmp(av[5], "stream")) {
+		nslots = SHM_SLOTS;
+		msgs_per_iter = (XFERUNIT + bufsize - 1) / bufsize;
+		if (sample_batch) {
+			fprintf(stderr, "%s: -H only applies to handoff\n",
+				av[0]);
+			exit(1);
+		}
+	} else if (!strcmp(av[5], "handoff")) {
+		nslots = 1;
+		msgs_per_iter = 1;
+	} else {
+		fprintf(stderr, "%s: mode must be stream or handoff\n", av[0]);
+		exit(1);
+	}
+	if (bufsize == 0) {
+		fprintf(stderr, "%s: bad transfer size\n", av[0]);
+		exit(1);
+	}
+
+	/* Set up the control block and the ring */
+	ctl = (struct shm_ctl *)mmap(NULL, sizeof(struct shm_ctl),
+	    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (ctl == (struct shm_ctl *)MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	wake_pshared = 1;
+	len = page_roundup((unsigned long)nslots * bufsize);
+	if ((ring = shm_create(type, len)) == NULL) {
+		fprintf(stderr, "%s: cannot make %luKB of %s shared memory\n",
+			av[0], len >> 10, av[3]);
+		exit(1);
+	}
+	bzero(ring, len);
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+#ifndef COLD_CACHE
+	/*
+	 * Generate the appropriate number of iterations so the test takes
+	 * at least one second.
+	 */
+	if (niter == 0) {
+		niter = gen_iterations(&do_shmxfer, clock_multiplier);
+		printf("%d\n",niter);
+		return (0);
+	}
+
+	/*
+	 * Take the real data and average to get a result
+	 */
+	do_shmxfer(1, &totaltime); /* prime caches */
+#else
+	niter = 1;
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_shmxfer(niter, &totaltime);
+		if (nslots == 1)
+			output_latency(totaltime, niter);
+		else
+			output_bandwidth((double)niter * msgs_per_iter *
+					 bufsize, totaltime);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+/*
+ * Make a shared mapping of len bytes that a fork()ed child will share.
+ * The name or id is removed straight away; the mapping stays until exit.
+ * Returns NULL if the system can't do it.
+ */
+char *
+shm_create(type, len)
+	int type;
+	unsigned long len;
+{
+	char	*p = NULL;
+	char	name[64];
+	int	fd = -1, id, huge = 0;
+
+	if (page_policy == PAGE_2M)
+		huge = 21;
+	else if (page_policy == PAGE_1G)
+		huge = 30;
+
+	switch (type) {
+	case SHM_MEMFD:
+#ifdef MFD_CLOEXEC
+#ifdef MFD_HUGETLB
+		if (huge)
+			huge = MFD_HUGETLB | (huge << MAP_HUGE_SHIFT);
+#else
+		if (huge)
+			break;
+#endif
+		if ((fd = memfd_create("bw_shm", huge)) == -1)
+			perror("memfd_create");
+#endif
+		break;
+	case SHM_POSIX:
+		if (huge)
+			break;		/* /dev/shm is tmpfs */
+		sprintf(name, "/bw_shm.%d", (int)getpid());
+		fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+		if (fd == -1)
+			perror(name);
+		else
+			shm_unlink(name);
+		break;
+	case SHM_SYSV:
+#ifdef SHM_HUGETLB
+		if (huge)
+			huge = SHM_HUGETLB | (huge << MAP_HUGE_SHIFT);
+#else
+		if (huge)
+			break;
+#endif
+		if ((id = shmget(IPC_PRIVATE, len, IPC_CREAT|0600|huge)) == -1) {
+			perror("shmget");
+			break;
+		}
+		p = shmat(id, NULL, 0);
+		shmctl(id, IPC_RMID, NULL);
+		if (p == (char *)-1) {
+			perror("shmat");
+			p = NULL;
+		}
+		break;
+	}
+	if (fd != -1) {
+		if (ftruncate(fd, len) == -1)
+			perror("ftruncate");
+		else {
+			p = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED,
+				 fd, 0);
+			if (p == MAP_FAILED) {
+				perror("mmap");
+				p = NULL;
+			}
+		}
+		close(fd);
+	}
+	if (p != NULL)
+		page_advise(p, len);
+	return (p);
+}
+
+/*
+ * Sleep on slot s until *ctr moves off v. The waiting flag tells the
+ * other side to post; the fences make sure that either it sees the flag
+ * or we see its update.
+ */
+void
+shm_wait(s, waiting, ctr, v)
+	struct wake_slot *s;
+	volatile int *waiting;
+	volatile unsigned long *ctr;
+	unsigned long v;
+{
+	while (*ctr == v) {
+		*waiting = 1;
+		__sync_synchronize();
+		if (*ctr == v)
+			wake_wait(s);
+		*waiting = 0;
+	}
+	__sync_synchronize();
+}
+
+/*
+ * Tell the other side that a counter has moved, if it is asleep
+ */
+void
+shm_post(s, waiting)
+	struct wake_slot *s;
+	volatile int *waiting;
+{
+	__sync_synchronize();
+	if (*waiting)
+		wake_post(s);
+}
+
+/*
+ * This function does all the work. The producer is a child process; the
+ * consumer, timed, is this one.
+ *
+ * Returns 0 if the benchmark was successful.
+ */
+int
+do_shmxfer(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	/*
+	 * 	Global parameters
+	 *
+	 * unsigned int bufsize;
+	 * int nslots, msgs_per_iter;
+	 * struct shm_ctl *ctl;
+	 * char *ring;
+	 */
+	unsigned long	n, todo;
+	char 		*buf;
+	int		termstat;
+
+	todo = (unsigned long)msgs_per_iter * num_iter;
+	buf = (char *) malloc(bufsize);
+	if (buf == NULL) {
+		perror("malloc");
+		exit(1);
+		/* NOTREACHED */
+	}
+	bzero(buf, bufsize);
+	ctl->head = ctl->tail = 0;
+	ctl->data_waiting = ctl->space_waiting = 0;
+	wake_init(&ctl->data, 1);
+	wake_init(&ctl->space, 1);
+
+	switch (fork()) {
+	case 0:			/* producer */
+		wake_post(&ctl->data);		/* ready */
+		for (n = 0; n < todo; n++) {
+			if (n >= nslots)
+				shm_wait(&ctl->space, &ctl->space_waiting,
+					 &ctl->tail, n - nslots);
+			bcopy(buf, ring + (n % nslots) * bufsize, bufsize);
+			__sync_synchronize();
+			ctl->head = n + 1;
+			shm_post(&ctl->data, &ctl->data_waiting);
+		}
+		exit(0);
+		/*NOTREACHED*/
+
+	case -1:
+		perror("fork");
+		exit(1);
+		/*NOTREACHED*/
+
+	default:		/* consumer */
+		wake_wait(&ctl->data);		/* producer is running */
+
+		start();	/* start timing */
+		for (n = 0; n < todo; n++) {
+			shm_wait(&ctl->data, &ctl->data_waiting,
+				 &ctl->head, n);
+			bcopy(ring + (n % nslots) * bufsize, buf, bufsize);
+			__sync_synchronize();
+			ctl->tail = n + 1;
+			shm_post(&ctl->space, &ctl->space_waiting);
+			sample_op(1);
+		}
+		*t = stop(NULL);	/* stop timing */
+
+		wait(&termstat); /* wait for producer to exit */
+	}
+
+	wake_done(&ctl->data, 1);
+	wake_done(&ctl->space, 1);
+	free(buf);		/* release memory */
+
+	return (0);
+}
@@ -83,16 +83,19 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 	unsigned int	xferred;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 4) {
-		fprintf(stderr, "Usage: %s%s iterations requestsize -s OR"
-		   "\n       %s%s iterations requestsize [-]serverhost\n",
-		    av[0], counter_argstring, av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 4) {
+		fprintf(stderr, "Usage: %s%s%s iterations requestsize -s OR"
+		   "\n       %s%s%s iterations requestsize [-]serverhost\n",
+		    av[0], counter_argstring, repeat_argstring,
+		    av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -149,9 +152,11 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_client(niter, &totaltime);	/* get TCP bandwidth */
-
-	output_bandwidth(niter * XFERUNIT, totaltime);
+	for (run = repeat_runs; run > 0; run--) {
+		do_client(niter, &totaltime);	/* get TCP bandwidth */
+		output_bandwidth((double)niter * XFERUNIT, totaltime);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -177,7 +182,8 @@ do_client(num_iter, t)
 	int     c;
 	int     bytes;
 #ifdef EVENT_COUNTERS
-	eventcounter_t c0, c1;
+	eventcounter_t cval;
+	int i;
 #endif
 
 	if (!bufsize) {
@@ -234,23 +240,21 @@ do_client(num_iter, t)
 		;
 	if (*buf == '\000')
 		buf++;
-	if (buf[0] == '@' && buf[1] == '1' && buf[2] == '@') {
-		buf += 3;
-		c0 = EVENTCOUNTERTSTR(buf);
+	/* Counter i comes back as a line "@<i+1>@<value>" */
+	for (i = 0; i < MAX_EVENTCOUNTERS && buf[0] == '@' &&
+		     atoi(buf + 1) == i + 1; i++) {
+		while (*(++buf) != '@')
+			;
+		buf++;
+		cval = EVENTCOUNTERTSTR(buf);
 		/* XXX THIS IS SUCH A HACK! */
-		set_eventcounter_val(0, c0);
-		eventcounter_active[0] = 1;
+		set_eventcounter_val(i, cval);
+		num_eventcounters = i + 1;
 		while (*(buf++) != '\n')
 			;
 		if (*buf == '\000')
 			buf++;
 	}
-	if (buf[0] == '@' && buf[1] == '2' && buf[2] == '@') {
-		buf += 3;
-		c1 = EVENTCOUNTERTSTR(buf);
-		set_eventcounter_val(1, c1);
-		eventcounter_active[1] = 1;
-	}
 
 	buf = obuf;
 #endif
@@ -307,6 +311,9 @@ absorb(int control, int data)
 	int	nread, save, nbytes;
 	char	*buf = valloc(bufsize);
 	clk_t	timing;
+#ifdef EVENT_COUNTERS
+	int	i;
+#endif
 
 	if (!buf) {
 		perror("valloc");
@@ -338,11 +345,8 @@ absorb(int control, int data)
 
 	fprintf(stderr, CLKTFMT"\n\000", timing);
 #ifdef EVENT_COUNTERS
-	if (eventcounter_active[0])
-		fprintf(stderr,"@1@"EVENTCOUNTERTFMT"\n\000",
-			get_eventcounter(0));
-	if (eventcounter_active[1])
-		fprintf(stderr,"@2@"EVENTCOUNTERTFMT"\n\000",
-			get_eventcounter(1));
+	for (i = 0; i < num_eventcounters; i++)
+		fprintf(stderr,"@%d@"EVENTCOUNTERTFMT"\n\000", i + 1,
+			get_eventcounter(i));
 #endif
 }
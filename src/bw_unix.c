@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * bw_unix.c - AF_UNIX socket bandwidth benchmark
+ *
+ * Usage: bw_unix iterations transfersize stream|seqpacket|dgram [sockbuf]
+ *
+ * Like bw_pipe, but through a socketpair of the given type (see
+ * lib_unix.c). Each write() and read() moves transfersize bytes; for
+ * seqpacket and dgram that is the message size, which must fit in the
+ * socket buffer. The send and receive buffers are set to sockbuf bytes
+ * (default SOCKBUF, as for bw_tcp); 0 leaves the system default.
+ */
+char	*id = "$Id$\n";
+
+#include <sys/wait.h>
+
+#include "common.c"
+#include "lib_unix.c"
+
+/* The worker function */
+int 	do_unixxfer(int num_iter, clk_t *time);
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+unsigned int 	bufsize;	/* the size of the request buffer */
+int		socktype;	/* SOCK_STREAM etc. */
+int		sockbuf = SOCKBUF;	/* socket buffer size */
+
+/* Default transfer: 4MB, as for bw_pipe */
+#define XFERUNIT	(4*1024*1024)
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	unsigned int	niter;
+	clk_t		totaltime;
+	int		run;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac < 4 || ac > 5) {
+		fprintf(stderr, "Usage: %s%s%s iterations transfersize %s "
+			"[sockbuf]\n", av[0], counter_argstring,
+			repeat_argstring, unix_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	bufsize = parse_bytes(av[2]);
+	if ((socktype = parse_unix_type(av[3])) == -1) {
+		fprintf(stderr, "%s: unknown or unsupported socket type %s\n",
+			av[0], av[3]);
+		exit(1);
+	}
+	if (ac == 5)
+		sockbuf = parse_bytes(av[4]);
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+#ifndef COLD_CACHE
+	/*
+	 * Generate the appropriate number of iterations so the test takes
+	 * at least one second.
+	 */
+	if (niter == 0) {
+		niter = gen_iterations(&do_unixxfer, clock_multiplier);
+		printf("%d\n",niter);
+		return (0);
+	}
+
+	/*
+	 * Take the real data and average to get a result
+	 */
+	do_unixxfer(1, &totaltime); /* prime caches */
+#else
+	niter = 1;
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		do_unixxfer(niter, &totaltime);	/* get socket bandwidth */
+		output_bandwidth((double)niter * XFERUNIT, totaltime);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+/*
+ * This function does all the work. It transfers XFERUNIT through the
+ * socketpair num_iter times, timing the entire operation.
+ *
+ * Returns 0 if the benchmark was successful.
+ */
+int
+do_unixxfer(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	/*
+	 * 	Global parameters
+	 *
+	 * unsigned int bufsize;
+	 * int socktype, sockbuf;
+	 */
+	int		sv[2];
+	unsigned long long todo, done = 0;
+	int		n;
+	char 		*buf;
+	int		termstat;
+
+	unix_pair(socktype, sv, sockbuf);
+
+	/* Amount to transfer */
+	todo = (unsigned long long)XFERUNIT * num_iter;
+
+	/* Allocate buffer */
+	buf = (char *) malloc(bufsize);
+	if (buf == NULL) {
+		perror("malloc");
+		exit(1);
+		/* NOTREACHED */
+	}
+
+	/* Spawn off a writer, then time the read */
+	switch (fork()) {
+	case 0:			/* writer */
+		close(sv[1]);
+		while ((done < todo) &&
+		       ((n = write(sv[0], buf, bufsize)) > 0))
+			done += n;
+		if (done < todo) {
+			/* a datagram reader would never see EOF */
+			perror("bw_unix: write");
+			kill(getppid(), SIGTERM);
+			exit(1);
+		}
+		exit(0);
+		/*NOTREACHED*/
+
+	case -1:
+		perror("fork");
+		exit(1);
+		/*NOTREACHED*/
+
+	default:		/* reader */
+		close(sv[0]);
+
+		/* wait for writer */
+		sleep(1);
+
+		start();	/* start timing */
+		while ((done < todo) &&
+		       ((n = read(sv[1], buf, bufsize)) > 0))
+			done += n;
+		*t = stop(NULL);	/* stop timing */
+
+		wait(&termstat); /* wait for writer to exit */
+		if (done < todo) {
+			fprintf(stderr, "bw_unix: short transfer\n");
+			exit(1);
+		}
+	}
+
+	close(sv[1]);
+	free(buf);		/* release memory */
+
+	return (0);
+}
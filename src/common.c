@@ -45,18 +45,34 @@
 #define CYCLE_COUNTER
 #  if defined(i386)
 #    include "arch/i386/cyclecounter.c"
-#    include "arch/i386/eventcounter.c"
+#  elif defined(__x86_64__)
+#    include "arch/x86_64/cyclecounter.c"
 #  else
 #    error Event counters not supported on this architecture
 #  endif
+#  if defined(__linux__)
+#    include "os/linux/eventcounter.c"
+#  else
+#    include "arch/i386/eventcounter.c"
+#  endif
 #elif defined(CYCLE_COUNTER)
 #  if defined(i386)
 #    include "arch/i386/cyclecounter.c"
+#  elif defined(__x86_64__)
+#    include "arch/x86_64/cyclecounter.c"
 #  else
 #    error Cycle counter not supported on this architecture
 #  endif
 #else
-#  ifdef COLD_CACHE
+/*
+ * Without counters, use the POSIX monotonic clock where we know it is
+ * cheap and has nanosecond resolution; otherwise fall back to
+ * gettimeofday(). Define NO_MONOTONIC_CLOCK to force the fallback.
+ */
+#  if defined(__linux__) && !defined(NO_MONOTONIC_CLOCK)
+#    define MONOTONIC_CLOCK
+#  endif
+#  if defined(COLD_CACHE) && !defined(MONOTONIC_CLOCK)
 #  warning Cold cache results are not reliable without cycle counters
 #  endif
 #endif
@@ -36,12 +36,36 @@
  * The multiplier for the clock, used to convert cycles to time in some
  * cases. In units of microseconds per clock-tick.
  */
-float clock_multiplier = 1.0;
+#if defined(MONOTONIC_CLOCK) && !defined(CYCLE_COUNTER)
+#define DEFAULT_CLOCK_MULTIPLIER	0.001	/* clock ticks in nanoseconds */
+#else
+#define DEFAULT_CLOCK_MULTIPLIER	1.0
+#endif
+float clock_multiplier = DEFAULT_CLOCK_MULTIPLIER;
+
+#if defined (CYCLE_COUNTER)
+/*
+ * Set the clock multiplier from its command-line argument. Where the
+ * architecture can derive it (CYCLE_COUNTER_AUTOMULT), "auto" asks it
+ * to do so rather than trusting a value measured by mhz-counter.
+ */
+static void
+set_clock_multiplier(char *arg)
+{
+#ifdef CYCLE_COUNTER_AUTOMULT
+	if (!strcmp(arg, "auto")) {
+		clock_multiplier = cycle_counter_multiplier();
+		return;
+	}
+#endif
+	clock_multiplier = (float)atof(arg);
+}
+#endif
 
 #if defined (EVENT_COUNTERS)
-static char *counter_argstring = " [-c1 csel1] [-c2 csel2] clock_multiplier";
+static char *counter_argstring = " [-e event[,event...]] clock_multiplier";
 
-static int eventcounter_active[2] = {0, 0};
+static int num_eventcounters = 0;
 
 /*
  * Parse the clock multiplier and event counter selectors; 
@@ -50,6 +74,7 @@ static int eventcounter_active[2] = {0, 0};
 int parse_counter_args(int *acp, char ***avp)
 {
 	char *av0 = (*avp)[0];
+	char *ev;
 	
 	/*
 	 * Start out with default, sane values for the counters in case
@@ -58,21 +83,21 @@ int parse_counter_args(int *acp, char ***avp)
 	select_eventcounter_defaults();
 
 	/* 
-	 * Be simplistic: assume that c1 always preceeds c2, and don't do
-	 * any error-checking (since this is invoked by the driver anyway).
+	 * The event list is comma-separated; the backend limits its
+	 * length to what the hardware can count at once. Don't do much
+	 * error-checking (since this is invoked by the driver anyway).
 	 */
-	if (*acp >= 3 && !strcmp((*avp)[1], "-c1")) {
-		/* handle c1, update argc by 2, argv by 2 */
-		select_eventcounter(0, (*avp)[2]);
-		eventcounter_active[0] = 1;
-
-		*acp -= 2;
-		*avp += 2;
-	}
-	if (*acp >= 3 && !strcmp((*avp)[1], "-c2")) {
-		/* handle c2, update argc by 2, argv by 2 */
-		select_eventcounter(1, (*avp)[2]);
-		eventcounter_active[1] = 1;
+	if (*acp >= 3 && !strcmp((*avp)[1], "-e")) {
+		for (ev = strtok((*avp)[2], ","); ev != NULL;
+		     ev = strtok(NULL, ",")) {
+			if (num_eventcounters >= MAX_EVENTCOUNTERS) {
+				fprintf(stderr, "at most %d event counters\n",
+					MAX_EVENTCOUNTERS);
+				return 1;
+			}
+			select_eventcounter(num_eventcounters, ev);
+			num_eventcounters++;
+		}
 
 		*acp -= 2;
 		*avp += 2;
@@ -84,7 +109,7 @@ int parse_counter_args(int *acp, char ***avp)
 		return 1;
 	}
 
-	clock_multiplier = (float)atof((*avp)[1]);
+	set_clock_multiplier((*avp)[1]);
 	(*acp)--;
 	(*avp)++;
 	(*avp)[0] = av0;
@@ -103,7 +128,7 @@ int parse_counter_args(int *acp, char ***avp)
 		return 1;
 
 	(*acp)--;
-	clock_multiplier = (float)atof((*avp)[1]);
+	set_clock_multiplier((*avp)[1]);
 	(*avp)[1] = (*avp)[0];
 	(*avp)++;
 	return 0;
@@ -112,7 +137,7 @@ int parse_counter_args(int *acp, char ***avp)
 static char *counter_argstring = "";
 int parse_counter_args(int *acp, char ***avp)
 {
-	clock_multiplier = 1.0;
+	clock_multiplier = DEFAULT_CLOCK_MULTIPLIER;
 	return 0;
 }
 #endif
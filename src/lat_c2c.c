@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_c2c.c - core-to-core cache line transfer latency
+ *
+ * usage: lat_c2c niter store|cas shared|false|multi [cpulist]
+ *
+ * Two threads, each spinning on its own CPU, hand a cache line back and
+ * forth niter times; the time per handoff is the latency of moving a
+ * modified line from one CPU's cache to the other's. This is done for
+ * every ordered pair of CPUs in cpulist (by default, all those the
+ * process may run on), and the result is printed as a matrix in
+ * nanoseconds: row = CPU that starts each round trip, column = CPU
+ * that answers.
+ *
+ * The handshake is made with plain stores and loads ("store") or with
+ * compare-and-swap ("cas"), on
+ *
+ *	shared	one word that both threads write in turn
+ *	false	two words in the same line, one written by each thread
+ *		(false sharing)
+ *
+ * "multi" instead runs 1, 2, ... N writers at once on the first N CPUs
+ * of the list, all writing one line (with "cas", atomic adds to one
+ * word; with "store", stores to a word of their own), and prints the
+ * time per write for each number of writers.
+ *
+ * No kernel is involved; all threads busy-wait. Pairs where both CPUs
+ * are the same are skipped.
+ */
+char	*id = "$Id$\n";
+
+#include "common.c"
+#include "lib_thread.c"
+
+#define C2C_SHARED	0
+#define C2C_FALSE	1
+#define C2C_MULTI	2
+
+#define C2C_WARMUP	1000		/* untimed round trips per pair */
+#define LINE_WORDS	8		/* longs in a 64-byte line */
+
+/* Worker functions */
+int	do_pair();
+int	do_multi();
+void	multi_worker();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int		mode;			/* C2C_* */
+int		use_cas;		/* cas rather than store */
+int		pair_a, pair_b;		/* CPUs of the pair being timed */
+int		pair_niter;		/* round trips for the responder */
+volatile long	*line;			/* the line; page-aligned */
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	clk_t		t;
+	int		ncpus, i, j;
+	unsigned int	niter;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || (ac != 4 && ac != 5)) {
+		fprintf(stderr, "usage: %s%s iterations store|cas "
+			"shared|false|multi [cpulist]\n",
+			av[0], counter_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (!strcmp(av[2], "cas"))
+		use_cas = 1;
+	else if (strcmp(av[2], "store")) {
+		fprintf(stderr, "%s: handshake must be store or cas\n", av[0]);
+		exit(1);
+	}
+	if (!strcmp(av[3], "shared"))
+		mode = C2C_SHARED;
+	else if (!strcmp(av[3], "false"))
+		mode = C2C_FALSE;
+	else if (!strcmp(av[3], "multi"))
+		mode = C2C_MULTI;
+	else {
+		fprintf(stderr, "%s: mode must be shared, false or multi\n",
+			av[0]);
+		exit(1);
+	}
+#ifdef NO_THREADS
+	fprintf(stderr, "%s: threads not supported on this system\n", av[0]);
+	exit(1);
+#endif
+	nthreads = 1;
+	ncpus = (ac == 5) ? parse_cpulist(av[4]) : default_cpulist();
+	if (ncpus < (mode == C2C_MULTI ? 1 : 2)) {
+		fprintf(stderr, "%s: need a list of at least %d CPU%s\n",
+			av[0], mode == C2C_MULTI ? 1 : 2,
+			mode == C2C_MULTI ? "" : "s");
+		exit(1);
+	}
+
+	if ((line = (volatile long *)valloc(getpagesize())) == NULL) {
+		perror("valloc");
+		exit(1);
+	}
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+	if (niter == 0) {
+		/*
+		 * Time the first pair (or one writer); every other pair
+		 * uses the same count, so choose something much smaller
+		 * than a second's worth for large lists.
+		 */
+		if (mode == C2C_MULTI) {
+			nthreads = 1;
+			niter = gen_iterations(&do_multi, clock_multiplier);
+		} else {
+			pair_a = thread_cpu[0];
+			pair_b = thread_cpu[1];
+			niter = gen_iterations(&do_pair, clock_multiplier);
+		}
+		printf("%d\n", niter);
+		return (0);
+	}
+
+	if (mode == C2C_MULTI) {
+		printf("writers   ns/write\n");
+		for (nthreads = 1; nthreads <= ncpus; nthreads++) {
+			do_multi(niter, &t);
+			printf("%7d %10.2f\n", nthreads,
+			       (double)t * clock_multiplier * 1000.0 /
+			       (10.0 * niter));
+		}
+		return (0);
+	}
+
+	printf("%5s", "");
+	for (j = 0; j < ncpus; j++)
+		printf(" %7d", thread_cpu[j]);
+	printf("\n");
+	for (i = 0; i < ncpus; i++) {
+		printf("%5d", thread_cpu[i]);
+		for (j = 0; j < ncpus; j++) {
+			if (thread_cpu[i] == thread_cpu[j]) {
+				printf(" %7s", "-");
+				continue;
+			}
+			pair_a = thread_cpu[i];
+			pair_b = thread_cpu[j];
+			do_pair(niter, &t);
+			printf(" %7.1f", (double)t * clock_multiplier *
+			       1000.0 / (2.0 * niter));
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+	return (0);
+}
+
+/*
+ * Do round trips [from, to) of the handshake. Side 0 starts each round
+ * trip and side 1 answers.
+ */
+void
+handoff(side, from, to)
+	int side;
+	long from, to;
+{
+	volatile long *mine = &line[side], *theirs = &line[1 - side];
+	long k, v;
+
+	if (mode == C2C_SHARED) {
+		for (k = from; k < to; k++) {
+			v = 2 * k + side;
+			if (use_cas) {
+				while (!__sync_bool_compare_and_swap(&line[0],
+								     v, v + 1))
+					;
+			} else {
+				while (line[0] != v)
+					;
+				line[0] = v + 1;
+			}
+		}
+		if (side == 0)
+			while (line[0] != 2 * to)	/* last answer */
+				;
+		return;
+	}
+
+	/* C2C_FALSE */
+	for (k = from; k < to; k++) {
+		if (side == 1)
+			while (*theirs != k + 1)
+				;
+		if (use_cas)
+			__sync_bool_compare_and_swap(mine, k, k + 1);
+		else
+			*mine = k + 1;
+		if (side == 0)
+			while (*theirs != k + 1)
+				;
+	}
+}
+
+#ifndef NO_THREADS
+void *
+responder(arg)
+	void *arg;
+{
+	thread_pin(pair_b);
+	handoff(1, 0L, (long)pair_niter + C2C_WARMUP);
+	return (NULL);
+}
+
+/*
+ * Worker function: num_iter round trips between pair_a (this thread)
+ * and pair_b
+ */
+int
+do_pair(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	pthread_t	tid;
+
+	line[0] = line[1] = 0;
+	pair_niter = num_iter;
+	thread_pin(pair_a);
+	if (pthread_create(&tid, NULL, responder, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+	handoff(0, 0L, (long)C2C_WARMUP);
+	start();
+	handoff(0, (long)C2C_WARMUP, (long)num_iter + C2C_WARMUP);
+	*t = stop(NULL);
+	pthread_join(tid, NULL);
+	return (0);
+}
+#else /* NO_THREADS */
+int
+do_pair(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	*t = 0;
+	return (0);
+}
+#endif /* NO_THREADS */
+
+/*
+ * Multi-writer worker: num_iter*10 writes to the shared line (ten per
+ * iteration, so that a second's worth of plain stores fits in an int)
+ */
+#define FIVE(x)	x x x x x
+
+void
+multi_worker(id, num_iter)
+	int id, num_iter;
+{
+	volatile long *w = &line[use_cas ? 0 : id % LINE_WORDS];
+	int i;
+
+	thread_begin(id);
+	if (use_cas) {
+		for (i = num_iter; i > 0; i--) {
+			FIVE(__sync_fetch_and_add(w, 1);)
+			FIVE(__sync_fetch_and_add(w, 1);)
+		}
+	} else {
+		for (i = num_iter; i > 0; i--) {
+			FIVE(*w = i;)
+			FIVE(*w = i;)
+		}
+	}
+	thread_end(id);
+}
+
+int
+do_multi(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	thread_run(multi_worker, num_iter, t);
+	return (0);
+}
@@ -62,6 +62,7 @@ main(ac, av)
 	char  **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 	int i;
 
@@ -69,10 +70,12 @@ main(ac, av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations -s OR"
-		   "\n       %s%s iterations [-]serverhost\n",
-		    av[0], counter_argstring, av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 3) {
+		fprintf(stderr, "Usage: %s%s%s iterations -s OR"
+		   "\n       %s%s%s iterations [-]serverhost\n",
+		    av[0], counter_argstring, repeat_argstring,
+		    av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -131,9 +134,11 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_client(niter, &totaltime);
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		do_client(niter, &totaltime);
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
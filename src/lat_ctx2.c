@@ -42,7 +42,7 @@ char	*id = "$Id: lat_ctx2.c,v 1.2 1997/06/27 00:33:58 abrown Exp $\n";
 #include <sys/wait.h>
 #include <fcntl.h>
 
-#define MAX_PROCS		128
+#define MAX_PROCS		65536	/* also limited by open files, process limits */
 
 #define OVERHEADAVG_LOOPS	20
 #define OVERHEADAVG_TAILS	0.2
@@ -61,7 +61,8 @@ void	killem(), child();
  */
 int	nprocs;			/* number of processes */
 int	sprocs;			/* size of each process */
-pid_t	pids[MAX_PROCS];	/* process ID's */
+pid_t	*pids;			/* process ID's */
+int	(*ring)[2];		/* the ring of pipes */
 int	*pbuffer;		/* memory buffer for procs to sum */
 int	*locdata;		/* proc's memory buffer for procs to sum */
 
@@ -71,16 +72,18 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime, overhead;
+	int		run;
 	unsigned int	niter, tmp;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 4) {
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 4) {
 		fprintf(stderr,
-			"usage: %s%s iterations footprint nprocs\n",
-			av[0], counter_argstring);
+			"usage: %s%s%s iterations footprint nprocs\n",
+			av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -89,12 +92,26 @@ main(ac, av)
 	sprocs = parse_bytes(av[2]);
 	nprocs = atoi(av[3]);
 
-	if (nprocs > MAX_PROCS) {
-		fprintf(stderr, "%s: maximum number of processes (%d) "
-			"exceeded\n",MAX_PROCS);
+	if (nprocs < 1 || nprocs > MAX_PROCS) {
+		fprintf(stderr, "%s: number of processes must be 1 to %d\n",
+			av[0], MAX_PROCS);
 		exit(1);
 	}
 
+	/*
+	 * Get the pid and pipe arrays; the overhead measurement holds the
+	 * whole ring of pipes in one process, so make sure it can have that
+	 * many files open.
+	 */
+	pids = (pid_t *)calloc(nprocs, sizeof(pid_t));
+	ring = (int (*)[2])malloc(nprocs * sizeof(*ring));
+	if (!pids || !ring) {
+		perror("malloc");
+		exit(1);
+	}
+	if (raise_fd_limit(2 * nprocs + 16))
+		exit(1);
+
 	/* initialize timing module (calculates timing overhead, etc) */
 	init_timing();
 
@@ -150,10 +167,12 @@ main(ac, av)
 #ifndef COLD_CACHE
 	do_ctxsw(1, &totaltime);		/* prime caches */
 #endif
-	do_ctxsw(niter, &totaltime);		/* get total ctxsw time */
-
-	totaltime -= overhead * (clk_t)(niter*nprocs); /* remove overhead */
-	output_latency(totaltime, niter*nprocs);
+	for (run = repeat_runs; run > 0; run--) {
+		do_ctxsw(niter, &totaltime);		/* get total ctxsw time */
+		totaltime -= overhead * (clk_t)(niter*nprocs); /* remove overhead */
+		output_latency(totaltime, niter*nprocs);
+	}
+	repeat_done();
 
 	if (sprocs != 0)
 		free(pbuffer);
@@ -175,7 +194,7 @@ do_overhead1(num_iter, t)
 	int num_iter;
 	clk_t *t;
 {
-	int	p[MAX_PROCS][2];
+	int	(*p)[2] = ring;
 	int	msg = 0, sum, i, n, k;
 	char 	*data, *where;
 
@@ -274,27 +293,30 @@ do_ctxsw(num_iter, t)
 	int num_iter;
 	clk_t *t;
 {
-	int 	p[MAX_PROCS][2];
+	int 	(*p)[2] = ring;
 	int 	msg = 0, i, sum;
 
 	locdata = pbuffer;
 
 	/*
-	 * Get the pipes
+	 * Use the pipes as a ring, and fork off a bunch of processes
+	 * to pass the byte through their part of the ring. Each pipe is
+	 * made just before the child that writes it is forked, and the
+	 * parent closes the ends it does not need right away, so that each
+	 * child inherits only a few descriptors instead of the whole ring
+	 * (which would cost nprocs^2 descriptors in all).
 	 */
-	for (i = 0; i < nprocs; ++i) {
+	if (pipe(p[0]) == -1) {
+		perror("pipe in ctxsw");
+		exit(1);
+	}
+	signal(SIGTERM, SIG_IGN);
+     	for (i = 1; i < nprocs; ++i) {
 		if (pipe(p[i]) == -1) {
 			perror("pipe in ctxsw");
+			killem(i);
 			exit(1);
 		}
-	}
-
-	/*
-	 * Use the pipes as a ring, and fork off a bunch of processes
-	 * to pass the byte through their part of the ring.
-	 */
-	signal(SIGTERM, SIG_IGN);
-     	for (i = 1; i < nprocs; ++i) {
 		switch (pids[i] = fork()) {
 		    case -1:
 			perror("fork");
@@ -302,11 +324,14 @@ do_ctxsw(num_iter, t)
 			exit(1);
 
 		    case 0:	/* child */
+			close(p[0][1]);
+			close(p[i][0]);
 			child(p, i-1, i);
 			/* NOTREACHED */
 
 		    default:	/* parent */
-		    	;
+			close(p[i-1][0]);
+			close(p[i][1]);
 	    	}
 	}
 
@@ -340,13 +365,10 @@ do_ctxsw(num_iter, t)
 	 * Close the pipes and kill the children.
 	 */
      	killem(nprocs);
-     	for (i = 0; i < nprocs; ++i) {
-		close(p[i][0]);
-		close(p[i][1]);
-		if (i > 0) {
-			wait(0);
-		}
-	}
+	close(p[0][1]);
+	close(p[nprocs-1][0]);
+     	for (i = 1; i < nprocs; ++i)
+		wait(0);
 	return (0);
 }
 
@@ -355,7 +377,7 @@ do_ctxsw(num_iter, t)
  */
 void
 child(p, rd, wr)
-	int	p[MAX_PROCS][2];
+	int	(*p)[2];
 	int	rd, wr;
 {
 	int	msg, sum;
@@ -75,6 +75,7 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 	int 		(*workerfunc)(int, clk_t *);
 	struct timeval 	tv;
@@ -83,9 +84,10 @@ main(ac, av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 5) {
-		fprintf(stderr, "usage: %s%s iterations [create|delforw|delrev|delrand] filesize scratchdir\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 5) {
+		fprintf(stderr, "usage: %s%s%s iterations [create|delforw|delrev|delrand] filesize scratchdir\n",
+			av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -149,9 +151,11 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	(*workerfunc)(niter, &totaltime);	/* get cached reread */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		(*workerfunc)(niter, &totaltime);	/* get cached reread */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	/* Clean up state */
 	free(databuf);
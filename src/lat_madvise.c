@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_madvise.c - time returning memory to the system with madvise()
+ *
+ * usage: lat_madvise [-r runs] [-H batch] [-t threads [-C cpulist]]
+ *		      niter dontneed|free size
+ *
+ * Each iteration writes every page of a private anonymous region of the
+ * given size, untimed, and then times one madvise() of the whole region
+ * with MADV_DONTNEED (the pages are freed at once) or MADV_FREE (Linux;
+ * they are freed lazily, under memory pressure). This is what a malloc
+ * does when it gives unused memory back to the system. The result is
+ * the time per call; percentiles of the calls follow with -H. Since
+ * each call is timed on its own anyway, every call is recorded,
+ * whatever the batch size.
+ *
+ * Unmapping pages means flushing them from the TLB of every CPU that
+ * is running the address space. With "-t threads", threads 1 to
+ * threads-1 spin on their own CPUs, in user mode, for the whole test,
+ * so each call has to interrupt them to shoot down their TLB entries;
+ * thread 0 makes the calls. The region uses base pages
+ * (MADV_NOHUGEPAGE).
+ */
+char	*id = "$Id$\n";
+
+#include "common.c"
+#include "lib_thread.c"
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define LINE_WORDS	8		/* longs in a 64-byte line */
+
+/* Worker function */
+int do_madvise();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int		advice;			/* MADV_DONTNEED or MADV_FREE */
+unsigned long	size;			/* size of the region */
+char		*region;		/* the region */
+volatile long	spin_words[MAX_THREADS][LINE_WORDS];	/* for spinners */
+
+void	start_spinners();
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	clk_t		totaltime;
+	int		run;
+	unsigned int	niter;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || parse_thread_args(&ac, &av) ||
+	    ac != 4) {
+		fprintf(stderr, "usage: %s%s%s%s%s iterations dontneed|free "
+			"size\n", av[0], counter_argstring, repeat_argstring,
+			sample_argstring, thread_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (!strcmp(av[2], "dontneed"))
+		advice = MADV_DONTNEED;
+#ifdef MADV_FREE
+	else if (!strcmp(av[2], "free"))
+		advice = MADV_FREE;
+#endif
+	else {
+		fprintf(stderr, "%s: unknown or unsupported advice %s\n",
+			av[0], av[2]);
+		exit(1);
+	}
+	size = parse_bytes(av[3]) & ~(getpagesize() - 1);
+	if (size == 0) {
+		fprintf(stderr, "%s: size must be at least a page\n", av[0]);
+		exit(1);
+	}
+	region = mmap(0, size, PROT_READ|PROT_WRITE,
+		      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+#ifdef MADV_NOHUGEPAGE
+	madvise(region, size, MADV_NOHUGEPAGE);
+#endif
+	thread_pin(thread_cpu[0]);
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+	start_spinners();
+
+#ifndef COLD_CACHE
+	/*
+	 * Generate the appropriate number of iterations so the test takes
+	 * at least one second.
+	 */
+	if (niter == 0) {
+		niter = gen_iterations(&do_madvise, clock_multiplier);
+		printf("%d\n",niter);
+		return (0);
+	}
+
+	/*
+	 * Take the real data and average to get a result
+	 */
+	do_madvise(1, &totaltime);	/* prime caches, etc. */
+#else
+	niter = 1;
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_madvise(niter, &totaltime);
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+#ifndef NO_THREADS
+/*
+ * A thread that keeps the address space live on its CPU until the
+ * process exits
+ */
+void *
+spinner(arg)
+	void *arg;
+{
+	int id = (int)(long)arg;
+
+	thread_pin(thread_cpu[id]);
+	for (;;)
+		spin_words[id][0]++;
+	return (NULL);
+}
+
+void
+start_spinners()
+{
+	pthread_t	tid;
+	int		i;
+
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&tid, NULL, spinner,
+				   (void *)(long)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+}
+#else /* NO_THREADS */
+void
+start_spinners()
+{
+}
+#endif /* NO_THREADS */
+
+/*
+ * Worker function: num_iter madvise() calls, each on a freshly written
+ * region. *t is the time spent in the calls only.
+ */
+int
+do_madvise(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	unsigned long	pgsz = getpagesize();
+	volatile char	*p;
+	clk_t		t0, d, sum = 0;
+	int		i;
+
+	start();
+	for (i = num_iter; i > 0; i--) {
+		for (p = region; p < region + size; p += pgsz)
+			*p = 1;
+		t0 = read_clock();
+		if (madvise(region, size, advice) != 0) {
+			perror("madvise");
+			exit(1);
+		}
+		d = read_clock() - t0;
+		sum += d;
+		if (sample_batch)
+			latency_hist_add(d);
+	}
+	*t = stop(NULL);
+	*t = sum;
+
+	return (0);
+}
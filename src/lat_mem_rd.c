@@ -27,7 +27,36 @@
 /*
  * lat_mem_rd.c - measure memory load latency
  *
- * usage: lat_mem_rd clk_ns nloops path freemem stride [stride ...]
+ * usage: lat_mem_rd [-P 4k|thp|2m|1g] [-R page|all|huge] [-M maxchains]
+ *		    clk_ns nloops path freemem stride [stride ...]
+ *	  lat_mem_rd [-P 4k|thp|2m|1g] -T clk_ns nloops path freemem
+ *
+ * By default each load's address is the previous one plus the stride,
+ * a pattern that hardware prefetchers recognize and hide. With -R the
+ * same stride-sized slots are linked in a random cyclic order instead:
+ * "page" shuffles the slots within each page but visits the pages in
+ * order, "all" shuffles them over the whole range, and "huge" shuffles
+ * within each 2MB region of a buffer backed by transparent huge pages
+ * (where available), which removes most TLB misses from the result.
+ * -P selects the page size backing the buffer (see lib_pagealloc.c).
+ *
+ * With "-M maxchains", only the full buffer is measured, by walking k
+ * independent chains at once (interleaved over the same slots, in the
+ * order chosen by -R) for k = 1..maxchains. The results go to
+ * mlp_<size>_<stride>, one line per k:
+ *	k  ns-per-load  latency(k=1)/ns-per-load
+ * The last column is the effective memory-level parallelism, i.e. the
+ * number of misses the core keeps outstanding. No clock is subtracted
+ * for the load instruction, since with k > 1 the loads overlap.
+ *
+ * With -T, the test instead measures the cost of TLB misses at each
+ * size from step(): a "sparse" chain loads one cache line from each
+ * page of the range, and a "dense" chain loads the same number of
+ * lines packed into as few pages as possible, both in random order.
+ * The two touch the same amount of cache, so the difference is the
+ * page-walk cost. The results go to tlb_<pagesize>, one line per size:
+ *	size  pages  sparse-ns  dense-ns  walk-ns
+ * Run it with different -P policies to see what huge pages save.
  *
  * Based on:
  *	$lmbenchID: lat_mem_rd.c,v 1.1 1994/11/18 08:49:48 lm Exp $
@@ -39,12 +68,35 @@ char	*id = "$Id: lat_mem_rd.c,v 1.8 1997/06/27 00:33:58 abrown Exp $\n";
 #define	LOWER	512
 
 #include	"common.c"
+#include	"lib_numa.c"
+#include	"lib_pagealloc.c"
 
 #include	<stdio.h>
 #include	<fcntl.h>
+#include	<sys/mman.h>
 
 int 	step(int k);
 int 	do_loads();
+int 	do_mlp();
+void	mlp_sweep(char *path, int rlen, int len, int nloops);
+void	tlb_sweep(char *path, int len, int nloops);
+char	**tlb_chain();
+void	build_chains(int k, char **heads[]);
+
+/* Pointer chain orders for -R */
+#define	CHASE_STRIDE	0		/* addr[i] -> addr[i+stride] */
+#define	CHASE_PAGE	1		/* random within each page */
+#define	CHASE_ALL	2		/* random over the whole range */
+#define	CHASE_HUGE	3		/* random within each huge page */
+
+#define	HUGE_SIZE	(2*1024*1024)
+
+#define	MAX_CHAINS	32		/* most chains for -M */
+
+/* Chains for -T */
+#define	TLB_SPARSE	1		/* one line in each page */
+#define	TLB_DENSE	2		/* the same lines, packed */
+#define	TLB_LINE	64		/* cache line size */
 
 #if !defined(FILENAME_MAX) || FILENAME_MAX < 255
 #undef FILENAME_MAX
@@ -59,6 +111,12 @@ char 	*addr = NULL;
 int	range = 0;
 int	stride = 0;
 float	clk = 1.0;
+int	chase = CHASE_STRIDE;
+int	nchains = 1;		/* chains walked at once by do_mlp */
+int	mlp_max = 0;		/* -M maxchains, or 0 */
+unsigned int	mlp_loads;	/* loads done by the last do_mlp */
+volatile long	mlp_sink;	/* keeps the chain walks live */
+int	tlb = 0;		/* -T: 0, TLB_SPARSE or TLB_DENSE */
 
 int
 main(ac, av)
@@ -78,10 +136,44 @@ main(ac, av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac < 6) {
-		fprintf(stderr, "usage: %s%s clk_ns nloops outputpath memsize "
-			"stride [stride ...]\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_numa_args(&ac, &av) ||
+	    parse_page_args(&ac, &av))
+		ac = 0;
+	if (ac >= 3 && strcmp(av[1], "-R") == 0) {
+		if (strcmp(av[2], "page") == 0)
+			chase = CHASE_PAGE;
+		else if (strcmp(av[2], "all") == 0)
+			chase = CHASE_ALL;
+		else if (strcmp(av[2], "huge") == 0)
+			chase = CHASE_HUGE;
+		else
+			ac = 0;
+		av[2] = av[0];
+		av += 2;
+		ac -= 2;
+	}
+	if (ac >= 3 && strcmp(av[1], "-M") == 0) {
+		mlp_max = atoi(av[2]);
+		if (mlp_max < 1 || mlp_max > MAX_CHAINS)
+			ac = 0;
+		av[2] = av[0];
+		av += 2;
+		ac -= 2;
+	}
+	if (ac >= 2 && strcmp(av[1], "-T") == 0) {
+		tlb = TLB_SPARSE;
+		av[1] = av[0];
+		av++;
+		ac--;
+	}
+	if (ac < (tlb ? 5 : 6)) {
+		fprintf(stderr, "usage: %s%s%s%s [-R page|all|huge] "
+			"[-M maxchains] clk_ns nloops outputpath memsize "
+			"stride [stride ...]\n"
+			"       %s%s%s%s -T clk_ns nloops outputpath memsize\n",
+			av[0], counter_argstring, numa_argstring,
+			page_argstring, av[0], counter_argstring,
+			numa_argstring, page_argstring);
 		exit(1);
 	}
 
@@ -92,18 +184,30 @@ main(ac, av)
 
         len = parse_bytes(av[4]);
 
-	/* Get memory */
-        addr = (char *)malloc(len);
+	/* Get page-aligned memory; -R huge implies -P thp */
+	if (chase == CHASE_HUGE && page_policy == PAGE_DEFAULT)
+		page_setup(PAGE_THP);
+	addr = (char *)page_alloc(len);
 	if (!addr) {
-		perror("malloc");
+		perror("page_alloc");
 		exit(1);
 	}
+	numa_bind_mem(addr, len);
 
 	sprintf(fname,"%d",len);
 	rlen = strlen(fname);
 
+	if (tlb) {
+		tlb_sweep(path, len, nloops);
+		ac = 0;		/* no strides */
+	}
+
 	for (i = 5; i < ac; ++i) {
 		stride = atoi(av[i]);
+		if (mlp_max) {
+			mlp_sweep(path, rlen, len, nloops);
+			continue;
+		}
 		for (range = LOWER; range <= len; range = step(range)) {
 			/* Open the output file: rd_size_stride */
 			if (path[strlen(path) - 1] != '/')
@@ -144,12 +248,16 @@ main(ac, av)
 				 *
 				 * We account for loop overhead below.
 				 */
-#if defined(CYCLE_COUNTER)
+#if defined(CYCLE_COUNTER) || defined(MONOTONIC_CLOCK)
 				/*
-				 * Easy case: totaltime is already in cycles,
-				 * so just knock off the right amount.
+				 * Easy case: totaltime is in fine-grained
+				 * ticks (cycles, or nanoseconds), so just
+				 * knock off niter clocks' worth of them. An
+				 * invariant TSC need not tick once per
+				 * cycle, so convert through the multiplier.
 				 */
-				result = totaltime - (clk_t)niter;
+				result = totaltime - (clk_t)(((double)clk *
+				    (double)niter) / (1000.0 * clock_multiplier));
 #else
 				/*
 				 * Since we have no counters, totaltime is in
@@ -172,8 +280,10 @@ main(ac, av)
 		}
 	}
 
+	numa_check(addr, "buffer");
+
 	/* free the memory */
-	free(addr);
+	page_free(addr, len);
 
 	exit(0);
 }
@@ -186,6 +296,7 @@ do_loads(num_iter, t)
 	register char **p;
         register int i;
 	clk_t	ovr;
+	char	**first;
 	/*
 	  char	*addr;
 	  int	stride;
@@ -200,16 +311,23 @@ do_loads(num_iter, t)
 		return 1;
 	}
 
-     	for (i = 0; i < range; i += stride) {
-		char	*next;
-
-		p = (char **)&addr[i];
-		if (i + stride >= range) {
-			next = &addr[0];
-		} else {
-			next = &addr[i + stride];
+	if (tlb) {
+		first = tlb_chain();
+	} else if (chase != CHASE_STRIDE) {
+		build_chains(1, &first);
+	} else {
+		first = (char **)addr;
+		for (i = 0; i < range; i += stride) {
+			char	*next;
+
+			p = (char **)&addr[i];
+			if (i + stride >= range) {
+				next = &addr[0];
+			} else {
+				next = &addr[i + stride];
+			}
+			*p = next;
 		}
-		*p = next;
 	}
 
 	/*
@@ -222,7 +340,7 @@ do_loads(num_iter, t)
 #define	HUNDRED	FIFTY FIFTY
 
 	i = num_iter;
-	p = (char **)addr;
+	p = first;
 	start();
 	while (i > 0) {
 		HUNDRED
@@ -253,6 +371,338 @@ do_loads(num_iter, t)
 	return(0);
 }
 
+/*
+ * Run the -M sweep over the whole buffer for the current stride
+ */
+void
+mlp_sweep(char *path, int rlen, int len, int nloops)
+{
+	char	buf[64];
+	clk_t	totaltime;
+	float	ns, ns1 = 0.0;
+	int	niter, j, fd;
+
+	range = len;
+	if (path[strlen(path) - 1] != '/')
+		sprintf(fname,"%s/mlp_%0.*d_%05d", path,rlen,range,stride);
+	else
+		sprintf(fname,"%smlp_%0.*d_%05d", path,rlen,range,stride);
+	fd = open(fname, O_CREAT|O_APPEND|O_WRONLY, 0666);
+	if (fd == -1) {
+		fprintf(stderr, "can't open file %s: ",fname);
+		perror("error");
+		exit(1);
+	}
+
+	for (nchains = 1; nchains <= mlp_max; nchains++) {
+		if (nchains > range / stride)
+			break;		/* not enough slots */
+		niter = gen_iterations(&do_mlp, clock_multiplier*2.0);
+		niter = niter/1000; /* round down to 1000's */
+		niter *= 1000;
+		if (niter == 0)
+			niter = 1000;
+
+		for (j = 0; j < nloops; j++) {
+			do_mlp(niter, &totaltime);
+			ns = ((float)totaltime * 1000.0 / (float)mlp_loads) *
+			    clock_multiplier;
+			if (nchains == 1)
+				ns1 = ns;
+			sprintf(buf, "%d %.4f %.2f\n", nchains, ns,
+				ns > 0.0 ? ns1 / ns : 0.0);
+			if (write(fd, buf, strlen(buf)) != strlen(buf)) {
+				perror("file write");
+				exit(1);
+			}
+		}
+	}
+	close(fd);
+}
+
+/*
+ * Walk nchains chains at once, num_iter loads in all.
+ */
+#define	MLP_ROUND	switch (k) { \
+	case 32: p31 = (char **)*p31; \
+	case 31: p30 = (char **)*p30; \
+	case 30: p29 = (char **)*p29; \
+	case 29: p28 = (char **)*p28; \
+	case 28: p27 = (char **)*p27; \
+	case 27: p26 = (char **)*p26; \
+	case 26: p25 = (char **)*p25; \
+	case 25: p24 = (char **)*p24; \
+	case 24: p23 = (char **)*p23; \
+	case 23: p22 = (char **)*p22; \
+	case 22: p21 = (char **)*p21; \
+	case 21: p20 = (char **)*p20; \
+	case 20: p19 = (char **)*p19; \
+	case 19: p18 = (char **)*p18; \
+	case 18: p17 = (char **)*p17; \
+	case 17: p16 = (char **)*p16; \
+	case 16: p15 = (char **)*p15; \
+	case 15: p14 = (char **)*p14; \
+	case 14: p13 = (char **)*p13; \
+	case 13: p12 = (char **)*p12; \
+	case 12: p11 = (char **)*p11; \
+	case 11: p10 = (char **)*p10; \
+	case 10: p9 = (char **)*p9; \
+	case 9: p8 = (char **)*p8; \
+	case 8: p7 = (char **)*p7; \
+	case 7: p6 = (char **)*p6; \
+	case 6: p5 = (char **)*p5; \
+	case 5: p4 = (char **)*p4; \
+	case 4: p3 = (char **)*p3; \
+	case 3: p2 = (char **)*p2; \
+	case 2: p1 = (char **)*p1; \
+	case 1: p0 = (char **)*p0; \
+	}
+
+int
+do_mlp(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	register char **p0, **p1, **p2, **p3, **p4, **p5, **p6, **p7;
+	register char **p8, **p9, **p10, **p11, **p12, **p13, **p14, **p15;
+	register char **p16, **p17, **p18, **p19, **p20, **p21, **p22, **p23;
+	register char **p24, **p25, **p26, **p27, **p28, **p29, **p30, **p31;
+	register int i, k = nchains;
+	char	**heads[MAX_CHAINS];
+	clk_t	ovr;
+	int	c;
+
+	if (stride & (sizeof(char *) - 1)) {
+		fprintf(stderr, "list: stride must be aligned.\n");
+		return 1;
+	}
+	build_chains(k, heads);
+	for (c = k; c < MAX_CHAINS; c++)
+		heads[c] = heads[0];	/* unused */
+	p0 = heads[0];
+	p1 = heads[1];
+	p2 = heads[2];
+	p3 = heads[3];
+	p4 = heads[4];
+	p5 = heads[5];
+	p6 = heads[6];
+	p7 = heads[7];
+	p8 = heads[8];
+	p9 = heads[9];
+	p10 = heads[10];
+	p11 = heads[11];
+	p12 = heads[12];
+	p13 = heads[13];
+	p14 = heads[14];
+	p15 = heads[15];
+	p16 = heads[16];
+	p17 = heads[17];
+	p18 = heads[18];
+	p19 = heads[19];
+	p20 = heads[20];
+	p21 = heads[21];
+	p22 = heads[22];
+	p23 = heads[23];
+	p24 = heads[24];
+	p25 = heads[25];
+	p26 = heads[26];
+	p27 = heads[27];
+	p28 = heads[28];
+	p29 = heads[29];
+	p30 = heads[30];
+	p31 = heads[31];
+
+	i = num_iter;
+	start();
+	while (i > 0) {
+		MLP_ROUND
+		MLP_ROUND
+		MLP_ROUND
+		MLP_ROUND
+		i -= 4 * k;
+	}
+	*t = stop(NULL);
+	mlp_sink = (long)p0 ^ (long)p1 ^ (long)p2 ^ (long)p3 ^
+	    (long)p4 ^ (long)p5 ^ (long)p6 ^ (long)p7 ^
+	    (long)p8 ^ (long)p9 ^ (long)p10 ^ (long)p11 ^
+	    (long)p12 ^ (long)p13 ^ (long)p14 ^ (long)p15 ^
+	    (long)p16 ^ (long)p17 ^ (long)p18 ^ (long)p19 ^
+	    (long)p20 ^ (long)p21 ^ (long)p22 ^ (long)p23 ^
+	    (long)p24 ^ (long)p25 ^ (long)p26 ^ (long)p27 ^
+	    (long)p28 ^ (long)p29 ^ (long)p30 ^ (long)p31;
+	mlp_loads = num_iter - i;
+
+	/*
+	 * Calculate and remove loop overhead
+	 */
+	i = num_iter;
+	start();
+	while (i > 0) {
+		i -= 4 * k;
+	}
+	ovr = stop(NULL);
+	*t -= ovr;
+
+	return (0);
+}
+
+/*
+ * Link the stride-sized slots of addr[0..range) into k cycles that
+ * together visit every slot once: the slots are put in order (shuffled
+ * within groups of slots as selected by -R), and chain c takes every
+ * k-th slot starting at the c-th. heads[c] gets the first slot of
+ * chain c. The order
+ * depends only on range and stride, so every run over the same range
+ * walks the same chains.
+ */
+void
+build_chains(int nc, char **heads[])
+{
+	int	n, group, i, j, k, t, x, c;
+	int	*order;
+
+	n = (range + stride - 1) / stride;
+	order = (int *)malloc(n * sizeof(int));
+	if (!order) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+		order[i] = i;
+
+	if (chase == CHASE_STRIDE)
+		group = 1;
+	else if (chase == CHASE_ALL)
+		group = n;
+	else if (chase == CHASE_HUGE)
+		group = HUGE_SIZE / stride;
+	else
+		group = getpagesize() / stride;
+	if (group < 1)
+		group = 1;
+
+	srandom(range ^ (stride << 16));
+	for (i = 0; i < n; i += group) {
+		k = (n - i < group) ? n - i : group;
+		for (j = k - 1; j > 0; j--) {	/* Fisher-Yates */
+			t = random() % (j + 1);
+			x = order[i + j];
+			order[i + j] = order[i + t];
+			order[i + t] = x;
+		}
+	}
+
+	for (c = 0; c < nc; c++) {
+		for (i = c; i < n; i += nc) {
+			j = (i + nc < n) ? i + nc : c;	/* next in chain */
+			*(char **)&addr[order[i] * stride] =
+			    &addr[order[j] * stride];
+		}
+		heads[c] = (char **)&addr[order[c] * stride];
+	}
+
+	free(order);
+}
+
+/*
+ * Run the -T sweep: for each size from step() that spans at least two
+ * pages, time the sparse and the dense chain.
+ */
+void
+tlb_sweep(char *path, int len, int nloops)
+{
+	char	buf[128];
+	clk_t	totaltime;
+	float	ns[3];
+	int	niter, j, fd, pages, lastpages = 0;
+
+	if (path[strlen(path) - 1] != '/')
+		sprintf(fname,"%s/tlb_%lu", path, page_size);
+	else
+		sprintf(fname,"%stlb_%lu", path, page_size);
+	fd = open(fname, O_CREAT|O_APPEND|O_WRONLY, 0666);
+	if (fd == -1) {
+		fprintf(stderr, "can't open file %s: ",fname);
+		perror("error");
+		exit(1);
+	}
+
+	stride = TLB_LINE;
+	for (range = LOWER; range <= len; range = step(range)) {
+		pages = range / page_size;
+		if (pages < 2 || pages == lastpages)
+			continue;
+		lastpages = pages;
+		for (j = nloops; j > 0; j--) {
+			for (tlb = TLB_SPARSE; tlb <= TLB_DENSE; tlb++) {
+				niter = gen_iterations(&do_loads,
+						       clock_multiplier*2.0);
+				niter = niter/1000; /* round down to 1000's */
+				niter *= 1000;
+				if (niter == 0)
+					niter = 1000;
+				do_loads(niter, &totaltime);
+				ns[tlb] = ((float)totaltime * 1000.0 /
+					   (float)niter) * clock_multiplier;
+			}
+			sprintf(buf, "%d %d %.4f %.4f %.4f\n", range, pages,
+				ns[TLB_SPARSE], ns[TLB_DENSE],
+				ns[TLB_SPARSE] - ns[TLB_DENSE]);
+			if (write(fd, buf, strlen(buf)) != strlen(buf)) {
+				perror("file write");
+				exit(1);
+			}
+		}
+	}
+	close(fd);
+	tlb = 0;
+}
+
+/*
+ * Build the chain for the -T sweep: one slot per page of the range
+ * (at a line offset that varies from page to page, so that the slots
+ * do not all fall in the same cache sets), or, for the dense chain,
+ * the same number of consecutive lines. Both are walked in the same
+ * random order.
+ */
+char **
+tlb_chain()
+{
+	int	n, i, t, x;
+	int	*order;
+	char	**first;
+	char	*slot;
+
+	n = range / page_size;
+	order = (int *)malloc(n * sizeof(int));
+	if (!order) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+		order[i] = i;
+	srandom(range);
+	for (i = n - 1; i > 0; i--) {		/* Fisher-Yates */
+		t = random() % (i + 1);
+		x = order[i];
+		order[i] = order[t];
+		order[t] = x;
+	}
+
+#define	TLB_SLOT(k)	(tlb == TLB_SPARSE ? \
+	&addr[(k) * page_size + ((k) * TLB_LINE) % page_size] : \
+	&addr[(k) * TLB_LINE])
+
+	for (i = 0; i < n; i++) {
+		slot = TLB_SLOT(order[i]);
+		*(char **)slot = TLB_SLOT(order[(i + 1) % n]);
+	}
+	first = (char **)TLB_SLOT(order[0]);
+
+	free(order);
+	return (first);
+}
+
 int
 step(int k)
 {
@@ -27,7 +27,28 @@
 /*
  * lat_mmap.c - time how fast a mapping can be made and broken down
  *
- * Usage: lat_mmap size file
+ * Usage: lat_mmap [-r runs] [-t threads [-C cpulist]] size file
+ *		   [map|anon|fault]
+ *
+ * The operation timed depends on the mode:
+ *
+ *	map	(the default) mmap() size bytes of the file and munmap()
+ *		them again
+ *	anon	mmap() size bytes of private anonymous memory, write
+ *		every page, and munmap() it: the life of a large
+ *		allocation in malloc()
+ *	fault	one page fault in a part of size bytes of a region
+ *		shared by all the threads; every size bytes the thread
+ *		drops its part again with MADV_DONTNEED
+ *
+ * With -t, that many threads in the one address space do the operation
+ * at once, and the result is operations per second for the whole team
+ * followed by each thread's own, rather than the time per operation.
+ * This shows the contention on the address space's locks (mmap_sem /
+ * mmap_lock on Linux): map and anon change the address space layout in
+ * every operation, while the threads in fault mode only read it. Anon
+ * and fault use base pages (MADV_NOHUGEPAGE), so every page faults;
+ * they round size down to a page, and ignore the file argument.
  *
  * XXX - If an implementation did lazy address space mapping, this test
  * will make that system look very good.
@@ -40,6 +61,7 @@
 char	*id = "$Id: lat_mmap.c,v 1.7 1997/06/27 00:33:58 abrown Exp $\n";
 
 #include "common.c"
+#include "lib_thread.c"
 
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -49,8 +71,17 @@ char	*id = "$Id: lat_mmap.c,v 1.7 1997/06/27 00:33:58 abrown Exp $\n";
 
 #define	CHK(x)		if ((int)(x) == -1) { perror("x"); exit(1); }
 
-/* Worker function */
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define MMAP_MAP	0
+#define MMAP_ANON	1
+#define MMAP_FAULT	2
+
+/* Worker functions */
 int do_mmap();
+void mmap_thread();
 
 /*
  * Global variables: these are the parameters required by the worker routine.
@@ -59,6 +90,8 @@ int do_mmap();
  */
 int		fd;		/* file descriptor of file to map */
 unsigned int 	size;		/* size of region to map */
+int		mode;		/* MMAP_* */
+char		*shared;	/* fault: nthreads parts of size bytes */
 
 int
 main(ac, av)
@@ -66,6 +99,7 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 	struct stat sbuf;
 
@@ -73,21 +107,57 @@ main(ac, av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 4) {
-		fprintf(stderr, "usage: %s%s iterations size file\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_thread_args(&ac, &av) || (ac != 4 && ac != 5)) {
+		fprintf(stderr, "usage: %s%s%s%s iterations size file "
+			"[map|anon|fault]\n", av[0], counter_argstring,
+			repeat_argstring, thread_argstring);
 		exit(1);
 	}
 
 	/* parse command line parameters */
 	niter = atoi(av[1]);
 	size = parse_bytes(av[2]);
-	CHK(fd = open(av[3], 0));
-	CHK(fstat(fd, &sbuf));
-	if (sbuf.st_size < size) {
-		fprintf(stderr, "%s: file %s is not as big as size %d\n",
-		    av[0], av[3], size);
-		exit(1);
+	mode = MMAP_MAP;
+	if (ac == 5) {
+		if (!strcmp(av[4], "anon"))
+			mode = MMAP_ANON;
+		else if (!strcmp(av[4], "fault"))
+			mode = MMAP_FAULT;
+		else if (strcmp(av[4], "map")) {
+			fprintf(stderr, "%s: mode must be map, anon or "
+				"fault\n", av[0]);
+			exit(1);
+		}
+	}
+	if (mode == MMAP_MAP) {
+		CHK(fd = open(av[3], 0));
+		CHK(fstat(fd, &sbuf));
+		if (sbuf.st_size < size) {
+			fprintf(stderr, "%s: file %s is not as big as size "
+				"%d\n", av[0], av[3], size);
+			exit(1);
+		}
+	} else {
+		/* the file is not used; anon and fault work in pages */
+		size &= ~(getpagesize() - 1);
+		if (size == 0) {
+			fprintf(stderr, "%s: size must be at least a page\n",
+				av[0]);
+			exit(1);
+		}
+	}
+	if (mode == MMAP_FAULT) {
+		shared = mmap(0, (size_t)size * nthreads,
+			      PROT_READ|PROT_WRITE,
+			      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (shared == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+#ifdef MADV_NOHUGEPAGE
+		madvise(shared, (size_t)size * nthreads, MADV_NOHUGEPAGE);
+#endif
 	}
 
 	/* initialize timing module (calculates timing overhead, etc) */
@@ -114,41 +184,111 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_mmap(niter, &totaltime);	/* get cached reread */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		do_mmap(niter, &totaltime);	/* get cached reread */
+		if (threaded)
+			output_thread_rate((double)niter, totaltime);
+		else
+			output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
 
 /*
- * Worker function: does num_iter mmap/munmap pairs and times the entire
- * thing.
+ * Do num_iter operations as thread id
  */
-int
-do_mmap(num_iter, t)
-	int num_iter;
-	clk_t *t;
+void
+mmap_ops(id, num_iter)
+	int id, num_iter;
 {
 	int i;
+	unsigned long off, pgsz = getpagesize();
 	char *where;
+	volatile char *p;
 
-	/* Start clocks */
-	start();
-
-	for (i = num_iter; i > 0; i--) {
+	switch (mode) {
+	case MMAP_MAP:
+		for (i = num_iter; i > 0; i--) {
 #ifdef	MAP_FILE
-		where = mmap(0, size, PROT_READ, MAP_FILE|MAP_SHARED, fd, 0);
+			where = mmap(0, size, PROT_READ, MAP_FILE|MAP_SHARED,
+				     fd, 0);
 #else
-		where = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+			where = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
 #endif
-		if ((int)where == -1) {
-			perror("mmap");
-			exit(1);
+			if (where == MAP_FAILED) {
+				perror("mmap");
+				exit(1);
+			}
+			munmap(where, size);
 		}
-		munmap(where, size);
+		break;
+	case MMAP_ANON:
+		for (i = num_iter; i > 0; i--) {
+			where = mmap(0, size, PROT_READ|PROT_WRITE,
+				     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if (where == MAP_FAILED) {
+				perror("mmap");
+				exit(1);
+			}
+#ifdef MADV_NOHUGEPAGE
+			madvise(where, size, MADV_NOHUGEPAGE);
+#endif
+			for (p = where; p < where + size; p += pgsz)
+				*p = 1;
+			munmap(where, size);
+		}
+		break;
+	case MMAP_FAULT:
+		where = shared + (unsigned long)id * size;
+		for (i = num_iter, off = 0; i > 0; i--) {
+			where[off] = 1;
+			if ((off += pgsz) == size) {
+				madvise(where, size, MADV_DONTNEED);
+				off = 0;
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * Thread worker for -t
+ */
+void
+mmap_thread(id, num_iter)
+	int id, num_iter;
+{
+	thread_begin(id);
+	mmap_ops(id, num_iter);
+	thread_end(id);
+
+	/* Start the next run with the part unmapped */
+	if (mode == MMAP_FAULT)
+		madvise(shared + (unsigned long)id * size, size,
+			MADV_DONTNEED);
+}
+
+/*
+ * Worker function: does num_iter operations and times the entire thing.
+ */
+int
+do_mmap(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	if (threaded) {
+		thread_run(&mmap_thread, num_iter, t);
+		return (0);
 	}
+
+	/* Start clocks */
+	start();
+	mmap_ops(0, num_iter);
 	*t = stop(NULL);
 
+	if (mode == MMAP_FAULT)
+		madvise(shared, size, MADV_DONTNEED);
 	return (0);
 }
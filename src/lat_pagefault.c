@@ -1,74 +1,464 @@
 /*
- * lat_pagefault.c - time a page fault in
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ * Copyright (c) 1994 Larry McVoy.
  *
- * Usage: lat_pagefault file [file file...]
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
  *
- * Copyright (c) 1994 Larry McVoy.  Distributed under the FSF GPL with
- * additional restriction that results may published only if
- * (1) the benchmark is unmodified, and
- * (2) the version in the sccsid below is included in the report.
- * Support for this development by Sun Microsystems is gratefully acknowledged.
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * This work is derived from, but can no longer be called, lmbench.
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_pagefault.c - time a page fault
+ *
+ * Usage: lat_pagefault [-r runs] [-H batch] iterations
+ *		        minor|major|cow|thp|uffd size [file]
+ *
+ * Each iteration touches one page that is not mapped yet (or, for cow,
+ * is mapped read-only), so the result is the cost of one fault, from
+ * the faulting instruction until it completes. The pages come from a
+ * region of the given size, which is set up again, untimed, each time
+ * its pages run out:
+ *
+ *	minor	anonymous memory, written: the kernel zeroes a 4KB page
+ *	major	the file (at least size bytes), mapped shared and read
+ *		after its pages are dropped from the cache, so every
+ *		fault waits for the disk. Readahead is turned off with
+ *		MADV_RANDOM, so each fault reads one page.
+ *	cow	anonymous memory written before a fork(); while the
+ *		child is alive, each write by the parent copies a page
+ *	thp	anonymous memory with MADV_HUGEPAGE, written: each fault
+ *		zeroes and maps a 2MB page
+ *	uffd	anonymous memory registered with userfaultfd (Linux); a
+ *		second thread reads each fault and resolves it with
+ *		UFFDIO_COPY, so a fault includes two thread wakeups
+ *
+ * Since the setup is not timed, the time for a run is the sum of the
+ * timed stretches, as in lat_wake's oneway mode; event counts cover
+ * the setup too. Afterwards the number of faults the process took is
+ * checked with getrusage(), and a warning is printed if the touches
+ * did not fault as intended (e.g. "major" on a file in tmpfs, or "thp"
+ * with transparent huge pages disabled).
+ *
+ * Based on:
+ *	$lmbenchId: lat_pagefault.c,v 1.5 1995/11/08 01:39:50 lm Exp $
  */
-char	*id = "$Id: lat_pagefault.c,v 1.5 1995/11/08 01:39:50 lm Exp $\n";
+char	*id = "$Id$\n";
 
-#include "timing.c"
+#include "common.c"
+#include "lib_pagealloc.c"
 
 #include <sys/stat.h>
-#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#ifndef NO_THREADS
+#include <pthread.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/userfaultfd.h>
+#endif
+
+#if defined(__NR_userfaultfd) && defined(UFFDIO_COPY) && !defined(NO_THREADS)
+#define HAVE_UFFD
+#endif
 
-#define	CHK(x)	if ((x) == -1) { perror("x"); exit(1); }
+#define FAULT_MINOR	0
+#define FAULT_MAJOR	1
+#define FAULT_COW	2
+#define FAULT_THP	3
+#define FAULT_UFFD	4
 
+/* Worker function */
+int do_fault();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int		mode;			/* FAULT_* */
+int		fd = -1;		/* file for major faults */
+unsigned long	size;			/* size of the region */
+unsigned long	stride;			/* bytes per fault */
+char		*region;		/* cow: the region, kept populated */
+pid_t		cow_child;		/* cow: the process sharing it */
+int		cow_pipe;		/* cow: closing this ends it */
+long		faults;			/* faults taken in timed stretches */
+int		uffd = -1;		/* userfaultfd, for uffd */
+char		*uffd_src;		/* page copied in by the handler */
+
+void	fault_init();
+char	*fault_setup();
+void	fault_teardown();
+long	fault_count();
+
+int
 main(ac, av)
+	int ac;
 	char **av;
 {
-#ifdef	MS_INVALIDATE
-	int fd;
-	int i;
-	char *where;
-	struct stat sbuf;
-
-	write(2, id, strlen(id));
-	if (ac < 2) {
-		fprintf(stderr, "usage: %s file [file...]\n", av[0]);
+	clk_t		totaltime;
+	int		run;
+	unsigned int	niter;
+	struct stat	sbuf;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || (ac != 4 && ac != 5)) {
+		fprintf(stderr, "usage: %s%s%s%s iterations "
+			"minor|major|cow|thp|uffd size [file]\n", av[0],
+			counter_argstring, repeat_argstring, sample_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (!strcmp(av[2], "minor"))
+		mode = FAULT_MINOR;
+	else if (!strcmp(av[2], "major"))
+		mode = FAULT_MAJOR;
+	else if (!strcmp(av[2], "cow"))
+		mode = FAULT_COW;
+	else if (!strcmp(av[2], "thp"))
+		mode = FAULT_THP;
+	else if (!strcmp(av[2], "uffd"))
+		mode = FAULT_UFFD;
+	else {
+		fprintf(stderr, "%s: mode must be minor, major, cow, thp or "
+			"uffd\n", av[0]);
+		exit(1);
+	}
+#ifndef MADV_HUGEPAGE
+	if (mode == FAULT_THP) {
+		fprintf(stderr, "%s: thp not supported on this system\n",
+			av[0]);
+		exit(1);
+	}
+#endif
+#ifndef HAVE_UFFD
+	if (mode == FAULT_UFFD) {
+		fprintf(stderr, "%s: uffd not supported on this system\n",
+			av[0]);
 		exit(1);
 	}
-	for (i = 1; i < ac; ++i) {
-		CHK(fd = open(av[i], 0));
-		CHK(fstat(fd, &sbuf));
-		sbuf.st_size &= ~(16*1024 - 1);		/* align it */
-		if (sbuf.st_size < 1024*1024) {
-			fprintf(stderr, "%s: %s too small\n", av[0], av[i]);
+#endif
+	page_setup(mode == FAULT_THP ? PAGE_THP : PAGE_4K);
+	stride = mode == FAULT_THP ? page_size : getpagesize();
+	size = parse_bytes(av[3]) & ~(stride - 1);
+	if (size == 0) {
+		fprintf(stderr, "%s: size must be at least %lu\n", av[0],
+			stride);
+		exit(1);
+	}
+	if (mode == FAULT_MAJOR) {
+		if (ac != 5) {
+			fprintf(stderr, "%s: major needs a file\n", av[0]);
+			exit(1);
+		}
+		if ((fd = open(av[4], O_RDONLY)) == -1 ||
+		    fstat(fd, &sbuf) == -1) {
+			perror(av[4]);
+			exit(1);
+		}
+		if (sbuf.st_size < size) {
+			fprintf(stderr, "%s: file %s is not as big as size "
+				"%lu\n", av[0], av[4], size);
+			exit(1);
+		}
+	}
+	fault_init();
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+#ifndef COLD_CACHE
+	/*
+	 * Generate the appropriate number of iterations so the test takes
+	 * at least one second.
+	 */
+	if (niter == 0) {
+		niter = gen_iterations(&do_fault, clock_multiplier);
+		printf("%d\n",niter);
+		return (0);
+	}
+
+	/*
+	 * Take the real data and average to get a result
+	 */
+	do_fault(1, &totaltime);	/* prime caches, etc. */
+#else
+	niter = 1;
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_fault(niter, &totaltime);
+		output_latency(totaltime, niter);
+		if (faults < niter - niter / 10 ||
+		    (mode == FAULT_THP && faults > 2 * niter)) {
+			fflush(stdout);
+			fprintf(stderr, "%s: %ld faults for %u touches\n",
+				av[0], faults, niter);
+		}
+	}
+	repeat_done();
+
+	return (0);
+}
+
+#ifdef HAVE_UFFD
+/*
+ * The userfaultfd handler: resolve every fault by copying in uffd_src.
+ * It runs until the process exits.
+ */
+void *
+uffd_handler(arg)
+	void *arg;
+{
+	struct uffd_msg		msg;
+	struct uffdio_copy	copy;
+
+	for (;;) {
+		if (read(uffd, &msg, sizeof(msg)) != sizeof(msg)) {
+			if (errno == EINTR)
+				continue;
+			perror("read on userfaultfd");
+			exit(1);
+		}
+		if (msg.event != UFFD_EVENT_PAGEFAULT)
 			continue;
+		copy.dst = msg.arg.pagefault.address & ~(stride - 1);
+		copy.src = (unsigned long)uffd_src;
+		copy.len = stride;
+		copy.mode = 0;
+		copy.copy = 0;
+		if (ioctl(uffd, UFFDIO_COPY, &copy) == -1 &&
+		    errno != EEXIST) {
+			perror("UFFDIO_COPY");
+			exit(1);
 		}
-		where = mmap(0, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
-		if (msync(where, sbuf.st_size, MS_INVALIDATE) != 0) {
-			perror("msync");
+	}
+	return (NULL);
+}
+#endif /* HAVE_UFFD */
+
+/*
+ * One-time setup: the cow region, or the userfaultfd and its handler
+ */
+void
+fault_init()
+{
+#ifdef HAVE_UFFD
+	struct uffdio_api	api;
+	pthread_t		tid;
+	int			flags = O_CLOEXEC;
+#endif
+
+	if (mode == FAULT_COW) {
+		if ((region = page_alloc(size)) == NULL) {
+			perror("page_alloc");
+			exit(1);
+		}
+		memset(region, 1, size);
+	}
+#ifdef HAVE_UFFD
+	if (mode == FAULT_UFFD) {
+#ifdef UFFD_USER_MODE_ONLY
+		/* Unprivileged processes may only handle user faults */
+		flags |= UFFD_USER_MODE_ONLY;
+#endif
+		if ((uffd = syscall(__NR_userfaultfd, flags)) == -1) {
+			perror("userfaultfd");
+			exit(1);
+		}
+		api.api = UFFD_API;
+		api.features = 0;
+		if (ioctl(uffd, UFFDIO_API, &api) == -1) {
+			perror("UFFDIO_API");
+			exit(1);
+		}
+		if ((uffd_src = valloc(stride)) == NULL) {
+			perror("valloc");
+			exit(1);
+		}
+		memset(uffd_src, 1, stride);
+		if (pthread_create(&tid, NULL, uffd_handler, NULL) != 0) {
+			perror("pthread_create");
 			exit(1);
 		}
-		timeit(av[i], where, sbuf.st_size);
-		munmap(where, sbuf.st_size);
 	}
 #endif
-	exit(0);
 }
 
 /*
- * Get page fault times by going backwards in a stride of 256K
+ * Make a region whose pages will fault when touched
  */
-timeit(file, where, size)
-	char	*file, *where;
+char *
+fault_setup()
 {
-	char	*end = where + size - 16*1024;
-	int	sum = 0;
-	int	lowest = 0x7fffffff;
-
-	while (end > where) {
-		start();
-		sum += *end;
-		end -= 256*1024;
-		sum = stop(sum);
-		if (sum < lowest)
-			lowest = sum;
+	char	*p, c;
+	int	pfd[2];
+#ifdef HAVE_UFFD
+	struct uffdio_register	reg;
+#endif
+
+	switch (mode) {
+	case FAULT_MAJOR:
+		/* Drop the file's pages; the driver made sure they're clean */
+#ifdef POSIX_FADV_DONTNEED
+		posix_fadvise(fd, 0, size, POSIX_FADV_DONTNEED);
+#endif
+		p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+#ifdef MADV_RANDOM
+		madvise(p, size, MADV_RANDOM);
+#endif
+		return (p);
+	case FAULT_COW:
+		/*
+		 * The child holds the pages until fault_teardown() closes
+		 * the pipe.
+		 */
+		if (pipe(pfd) == -1) {
+			perror("pipe");
+			exit(1);
+		}
+		switch (cow_child = fork()) {
+		case -1:
+			perror("fork");
+			exit(1);
+		case 0:
+			/* wait for end of file */
+			close(pfd[1]);
+			if (read(pfd[0], &c, 1) == -1) {
+				perror("read on pipe");
+				_exit(1);
+			}
+			_exit(0);
+		}
+		close(pfd[0]);
+		cow_pipe = pfd[1];
+		return (region);
+	default:
+		if ((p = page_alloc(size)) == NULL) {
+			perror("page_alloc");
+			exit(1);
+		}
+#ifdef HAVE_UFFD
+		if (mode == FAULT_UFFD) {
+			reg.range.start = (unsigned long)p;
+			reg.range.len = size;
+			reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+			if (ioctl(uffd, UFFDIO_REGISTER, &reg) == -1) {
+				perror("UFFDIO_REGISTER");
+				exit(1);
+			}
+		}
+#endif
+		return (p);
+	}
+}
+
+void
+fault_teardown(p)
+	char *p;
+{
+	switch (mode) {
+	case FAULT_MAJOR:
+		munmap(p, size);
+		break;
+	case FAULT_COW:
+		close(cow_pipe);
+		waitpid(cow_child, NULL, 0);
+		break;
+	default:
+		page_free(p, size);
+		break;
+	}
+}
+
+/*
+ * The number of faults of the kind being measured taken so far
+ */
+long
+fault_count()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (mode == FAULT_MAJOR ? ru.ru_majflt : ru.ru_minflt);
+}
+
+/*
+ * Worker function: takes num_iter faults, setting up a new region each
+ * time the pages of the last one are used up. *t is the time spent in
+ * the touches only.
+ */
+int
+do_fault(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	unsigned long	npages = size / stride;
+	unsigned long	i, n;
+	volatile char	*p;
+	char		*base;
+	clk_t		t0, sum = 0;
+	long		f0;
+	int		done;
+
+	faults = 0;
+	start();
+	for (done = 0; done < num_iter; done += n) {
+		n = num_iter - done < npages ? num_iter - done : npages;
+		base = fault_setup();
+		f0 = fault_count();
+		p = base;
+		sample_begin();
+		t0 = read_clock();
+		if (mode == FAULT_MAJOR) {
+			for (i = n; i > 0; i--, p += stride) {
+				(void)*p;
+				sample_op(1);
+			}
+		} else {
+			for (i = n; i > 0; i--, p += stride) {
+				*p = 2;
+				sample_op(1);
+			}
+		}
+		sum += read_clock() - t0;
+		if (sample_count > 0)
+			sample_mark();	/* the rest of the last batch */
+		faults += fault_count() - f0;
+		fault_teardown(base);
 	}
-	fprintf(stderr, "Pagefaults on %s: %d usecs\n", file, lowest);
+	*t = stop(NULL);
+	*t = sum;
+
+	return (0);
 }
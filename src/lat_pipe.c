@@ -46,15 +46,17 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 2) {
-		fprintf(stderr, "usage: %s%s iterations\n", av[0],
-			counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || ac != 2) {
+		fprintf(stderr, "usage: %s%s%s%s iterations\n", av[0],
+			counter_argstring, repeat_argstring, sample_argstring);
 		exit(1);
 	}
 
@@ -85,9 +87,12 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_pipe(niter, &totaltime);	/* get cached reread */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_pipe(niter, &totaltime);	/* get cached reread */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -134,6 +139,7 @@ do_pipe(num_iter, t)
 				perror("read/write on pipe");
 				exit(1);
 			}
+			sample_op(1);
 		}
 		*t = stop(NULL);
 
@@ -60,15 +60,17 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 		/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 4) {
-		fprintf(stderr, "usage: %s%s iterations [null|simple|sh]"
-			" [static|dynamic]\n", av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 4) {
+		fprintf(stderr, "usage: %s%s%s iterations [null|simple|sh]"
+			" [static|dynamic]\n", av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -109,9 +111,11 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_pcreate(niter, &totaltime);	/* get cached reread */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		do_pcreate(niter, &totaltime);	/* get cached reread */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_queue.c - in-process message queue throughput and latency
+ *
+ * usage: lat_queue niter spsc|mpsc|mpmc|mutex|pipe producers consumers
+ *		    msgsize same|spread
+ *
+ * Producer threads each put niter messages of msgsize bytes into one
+ * queue, and consumer threads take them out until all have been taken.
+ * The queues are
+ *
+ *	spsc	a ring with one producer and one consumer: head and tail
+ *		counters only, no atomic operations
+ *	mpsc	a ring with a sequence number per slot (D. Vyukov's
+ *		bounded queue); producers claim slots with compare-and-
+ *		swap, the single consumer does not need to
+ *	mpmc	the same, with consumers also using compare-and-swap
+ *	mutex	a ring protected by a mutex, with condition variables to
+ *		wait while it is full or empty
+ *	pipe	a pipe; each message is one write() and one read()
+ *
+ * The rings have QUEUE_SLOTS slots. When a lock-free ring is full or
+ * empty the thread yields the CPU and tries again. Each message carries
+ * the time it was queued; the output is messages per second, then the
+ * 50th, 90th, 99th and 99.9th percentile and maximum time in the queue,
+ * in microseconds. With -r, the trimmed mean reported is the time per
+ * message in microseconds.
+ *
+ * With "same" every thread is pinned to one CPU; with "spread" the
+ * producers and then the consumers are pinned round-robin to the CPUs
+ * the process may run on.
+ */
+char	*id = "$Id$\n";
+
+#include "common.c"
+#include "lib_thread.c"
+#include <limits.h>
+
+#define Q_SPSC		0
+#define Q_MPSC		1
+#define Q_MPMC		2
+#define Q_MUTEX		3
+#define Q_PIPE		4
+
+#define QUEUE_SLOTS	1024		/* power of two */
+#define QUEUE_MAXMSG	PIPE_BUF	/* so pipe writes are atomic */
+#define QUEUE_SAMPLES	(1 << 20)	/* latencies kept per run */
+#define LINE		64
+
+/* Worker functions */
+int	do_queue();
+void	queue_worker();
+
+/*
+ * A counter on a cache line of its own
+ */
+struct qcount {
+	volatile unsigned long	v;
+	char			pad[LINE - sizeof(unsigned long)];
+};
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int		kind;			/* Q_* */
+int		nprod, ncons;		/* producer, consumer threads */
+int		msgsize;		/* bytes per message */
+unsigned long	total;			/* messages per run */
+unsigned long	sample_every;		/* keep every n'th latency */
+unsigned long	sample_cap;		/* latencies kept per consumer */
+clk_t		*samples[MAX_THREADS];	/* per consumer */
+unsigned long	nsamples[MAX_THREADS];
+
+char		*ring;			/* QUEUE_SLOTS slots */
+unsigned long	stride;			/* bytes per slot */
+struct qcount	qpos[2];		/* enqueue and dequeue positions */
+struct qcount	qcache[2];		/* spsc: last seen dequeue/enqueue */
+struct qcount	qclaimed;		/* messages claimed by consumers */
+int		qpipe[2];
+#ifndef NO_THREADS
+pthread_mutex_t	qlock;
+pthread_cond_t	qnotempty, qnotfull;
+#endif
+
+#define SEQ(slot)	(*(volatile unsigned long *)(slot))
+#define DATA(slot)	((slot) + sizeof(unsigned long))
+#define SLOT(pos)	(ring + ((pos) & (QUEUE_SLOTS - 1)) * stride)
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	static double	pcts[] = {50.0, 90.0, 99.0, 99.9};
+	clk_t		t;
+	int		run, i;
+	unsigned int	niter;
+	unsigned long	j;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 7) {
+		fprintf(stderr, "usage: %s%s%s iterations "
+			"spsc|mpsc|mpmc|mutex|pipe producers consumers msgsize "
+			"same|spread\n", av[0], counter_argstring,
+			repeat_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (!strcmp(av[2], "spsc"))
+		kind = Q_SPSC;
+	else if (!strcmp(av[2], "mpsc"))
+		kind = Q_MPSC;
+	else if (!strcmp(av[2], "mpmc"))
+		kind = Q_MPMC;
+	else if (!strcmp(av[2], "mutex"))
+		kind = Q_MUTEX;
+	else if (!strcmp(av[2], "pipe"))
+		kind = Q_PIPE;
+	else {
+		fprintf(stderr, "%s: unknown queue %s\n", av[0], av[2]);
+		exit(1);
+	}
+	nprod = atoi(av[3]);
+	ncons = atoi(av[4]);
+	msgsize = parse_bytes(av[5]);
+	if (nprod < 1 || ncons < 1 || nprod + ncons > MAX_THREADS) {
+		fprintf(stderr, "%s: need 1 to %d threads in all\n", av[0],
+			MAX_THREADS);
+		exit(1);
+	}
+	if ((kind == Q_SPSC && nprod > 1) ||
+	    ((kind == Q_SPSC || kind == Q_MPSC) && ncons > 1)) {
+		fprintf(stderr, "%s: too many producers or consumers for %s\n",
+			av[0], av[2]);
+		exit(1);
+	}
+	if (msgsize < sizeof(clk_t) || msgsize > QUEUE_MAXMSG) {
+		fprintf(stderr, "%s: message size must be %d to %d bytes\n",
+			av[0], (int)sizeof(clk_t), QUEUE_MAXMSG);
+		exit(1);
+	}
+#ifdef NO_THREADS
+	fprintf(stderr, "%s: threads not supported on this system\n", av[0]);
+	exit(1);
+#endif
+
+	/* Place the threads: producers first, then consumers */
+	nthreads = nprod + ncons;
+	if (!strcmp(av[6], "same")) {
+		i = nthreads;
+		nthreads = 1;
+		default_cpulist();
+		for (nthreads = i, i = 1; i < nthreads; i++)
+			thread_cpu[i] = thread_cpu[0];
+	} else if (!strcmp(av[6], "spread")) {
+		default_cpulist();
+	} else {
+		fprintf(stderr, "%s: placement must be same or spread\n",
+			av[0]);
+		exit(1);
+	}
+
+	/* Get the ring and the latency sample arrays */
+	stride = (sizeof(unsigned long) + msgsize + LINE - 1) & ~(LINE - 1);
+	if ((ring = valloc(QUEUE_SLOTS * stride)) == NULL) {
+		perror("valloc");
+		exit(1);
+	}
+	sample_cap = QUEUE_SAMPLES / ncons * 2 + 16;
+	for (i = 0; i < ncons; i++) {
+		samples[i] = (clk_t *)malloc(sample_cap * sizeof(clk_t));
+		if (!samples[i]) {
+			perror("malloc");
+			exit(1);
+		}
+	}
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+	if (niter == 0) {
+		niter = gen_iterations(&do_queue, clock_multiplier);
+		printf("%d\n", niter);
+		return (0);
+	}
+
+	do_queue(1, &t);		/* prime caches, etc. */
+	for (run = repeat_runs; run > 0; run--) {
+		do_queue(niter, &t);
+		repeat_record(t, (double)total, REPEAT_LATENCY);
+
+		latency_hist_reset();
+		for (i = 0; i < ncons; i++)
+			for (j = 0; j < nsamples[i]; j++)
+				latency_hist_add(samples[i][j]);
+		printf("%.0f", t > 0 ?
+		       total / ((double)t * clock_multiplier / 1000000.0) : 0.0);
+		for (i = 0; i < sizeof(pcts)/sizeof(pcts[0]); i++)
+			printf(" %.4f", (float)latency_hist_pct(pcts[i]) *
+			       clock_multiplier);
+		printf(" %.4f\n", (float)lh_max * clock_multiplier);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+/*
+ * spsc: only the producer writes qpos[0] and only the consumer writes
+ * qpos[1]; each keeps a copy of the other's counter in qcache and only
+ * re-reads it when the copy says the ring is full or empty.
+ */
+void
+spsc_put(msg)
+	char *msg;
+{
+	unsigned long pos = qpos[0].v;
+
+	while (pos - qcache[1].v >= QUEUE_SLOTS) {
+		qcache[1].v = qpos[1].v;
+		if (pos - qcache[1].v >= QUEUE_SLOTS)
+			sched_yield();
+	}
+	__sync_synchronize();	/* the consumer's reads before our write */
+	bcopy(msg, SLOT(pos), msgsize);
+	__sync_synchronize();
+	qpos[0].v = pos + 1;
+}
+
+void
+spsc_get(msg)
+	char *msg;
+{
+	unsigned long pos = qpos[1].v;
+
+	while (pos == qcache[0].v) {
+		qcache[0].v = qpos[0].v;
+		if (pos == qcache[0].v)
+			sched_yield();
+	}
+	__sync_synchronize();	/* the producer's write before our read */
+	bcopy(SLOT(pos), msg, msgsize);
+	__sync_synchronize();
+	qpos[1].v = pos + 1;
+}
+
+/*
+ * mpsc and mpmc: slot i of the ring holds sequence number i when it is
+ * free for the enqueue at position i, and i+1 once that message is in
+ * it; taking the message sets it to i+QUEUE_SLOTS, ready for the next
+ * lap. Positions are claimed with compare-and-swap when there may be
+ * more than one thread doing so.
+ */
+void
+ring_put(msg)
+	char *msg;
+{
+	unsigned long pos;
+	char *slot;
+	long dif;
+
+	for (;;) {
+		pos = qpos[0].v;
+		slot = SLOT(pos);
+		dif = (long)(SEQ(slot) - pos);
+		if (dif == 0 &&
+		    __sync_bool_compare_and_swap(&qpos[0].v, pos, pos + 1))
+			break;
+		if (dif < 0)
+			sched_yield();		/* full */
+	}
+	__sync_synchronize();	/* the last reader's reads before our write */
+	bcopy(msg, DATA(slot), msgsize);
+	__sync_synchronize();
+	SEQ(slot) = pos + 1;
+}
+
+void
+ring_get(msg)
+	char *msg;
+{
+	unsigned long pos;
+	char *slot;
+	long dif;
+
+	for (;;) {
+		pos = qpos[1].v;
+		slot = SLOT(pos);
+		dif = (long)(SEQ(slot) - (pos + 1));
+		if (dif == 0) {
+			if (kind == Q_MPSC) {
+				qpos[1].v = pos + 1;
+				break;
+			}
+			if (__sync_bool_compare_and_swap(&qpos[1].v, pos,
+							 pos + 1))
+				break;
+		}
+		if (dif < 0)
+			sched_yield();		/* empty */
+	}
+	__sync_synchronize();	/* the writer's write before our read */
+	bcopy(DATA(slot), msg, msgsize);
+	__sync_synchronize();
+	SEQ(slot) = pos + QUEUE_SLOTS;
+}
+
+#ifndef NO_THREADS
+/*
+ * mutex: a plain ring under one lock
+ */
+void
+mutex_put(msg)
+	char *msg;
+{
+	pthread_mutex_lock(&qlock);
+	while (qpos[0].v - qpos[1].v == QUEUE_SLOTS)
+		pthread_cond_wait(&qnotfull, &qlock);
+	bcopy(msg, SLOT(qpos[0].v), msgsize);
+	qpos[0].v++;
+	pthread_cond_signal(&qnotempty);
+	pthread_mutex_unlock(&qlock);
+}
+
+void
+mutex_get(msg)
+	char *msg;
+{
+	pthread_mutex_lock(&qlock);
+	while (qpos[0].v == qpos[1].v)
+		pthread_cond_wait(&qnotempty, &qlock);
+	bcopy(SLOT(qpos[1].v), msg, msgsize);
+	qpos[1].v++;
+	pthread_cond_signal(&qnotfull);
+	pthread_mutex_unlock(&qlock);
+}
+#endif /* NO_THREADS */
+
+/*
+ * pipe: writes of up to PIPE_BUF bytes are atomic, so every read of
+ * msgsize bytes gets one whole message.
+ */
+void
+pipe_put(msg)
+	char *msg;
+{
+	if (write(qpipe[1], msg, msgsize) != msgsize) {
+		perror("write on pipe");
+		exit(1);
+	}
+}
+
+void
+pipe_get(msg)
+	char *msg;
+{
+	int n, got;
+
+	for (got = 0; got < msgsize; got += n) {
+		if ((n = read(qpipe[0], msg + got, msgsize - got)) <= 0) {
+			perror("read on pipe");
+			exit(1);
+		}
+	}
+}
+
+void
+queue_put(msg)
+	char *msg;
+{
+	switch (kind) {
+	case Q_SPSC:	spsc_put(msg); break;
+	case Q_MPSC:
+	case Q_MPMC:	ring_put(msg); break;
+#ifndef NO_THREADS
+	case Q_MUTEX:	mutex_put(msg); break;
+#endif
+	case Q_PIPE:	pipe_put(msg); break;
+	}
+}
+
+void
+queue_get(msg)
+	char *msg;
+{
+	switch (kind) {
+	case Q_SPSC:	spsc_get(msg); break;
+	case Q_MPSC:
+	case Q_MPMC:	ring_get(msg); break;
+#ifndef NO_THREADS
+	case Q_MUTEX:	mutex_get(msg); break;
+#endif
+	case Q_PIPE:	pipe_get(msg); break;
+	}
+}
+
+/*
+ * Worker: threads 0..nprod-1 produce num_iter messages each, the rest
+ * consume until all nprod*num_iter have been taken.
+ */
+void
+queue_worker(id, num_iter)
+	int id, num_iter;
+{
+	char		msg[QUEUE_MAXMSG];
+	clk_t		stamp;
+	unsigned long	n, got = 0, kept = 0;
+	int		c = id - nprod;
+
+	bzero(msg, msgsize);
+	thread_begin(id);
+	if (id < nprod) {
+		for (n = num_iter; n > 0; n--) {
+			stamp = read_clock();
+			bcopy((char *)&stamp, msg, sizeof(stamp));
+			queue_put(msg);
+		}
+	} else {
+		for (;;) {
+			/* with one consumer, no need to share a count */
+			n = (ncons == 1) ? got++ :
+			    __sync_fetch_and_add(&qclaimed.v, 1);
+			if (n >= total)
+				break;
+			queue_get(msg);
+			if (n % sample_every == 0 && kept < sample_cap) {
+				bcopy(msg, (char *)&stamp, sizeof(stamp));
+				samples[c][kept++] = read_clock() - stamp;
+			}
+		}
+		nsamples[c] = kept;
+	}
+	thread_end(id);
+}
+
+/*
+ * Set up an empty queue, run the threads, and tear the queue down
+ */
+int
+do_queue(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	unsigned long i;
+
+	total = (unsigned long)num_iter * nprod;
+	sample_every = total / QUEUE_SAMPLES + 1;
+	qpos[0].v = qpos[1].v = qcache[0].v = qcache[1].v = qclaimed.v = 0;
+	for (i = 0; i < QUEUE_SLOTS; i++)
+		SEQ(ring + i * stride) = i;
+	if (kind == Q_PIPE && pipe(qpipe) == -1) {
+		perror("pipe");
+		exit(1);
+	}
+#ifndef NO_THREADS
+	if (kind == Q_MUTEX) {
+		pthread_mutex_init(&qlock, NULL);
+		pthread_cond_init(&qnotempty, NULL);
+		pthread_cond_init(&qnotfull, NULL);
+	}
+#endif
+
+	thread_run(queue_worker, num_iter, t);
+
+	if (kind == Q_PIPE) {
+		close(qpipe[0]);
+		close(qpipe[1]);
+	}
+#ifndef NO_THREADS
+	if (kind == Q_MUTEX) {
+		pthread_mutex_destroy(&qlock);
+		pthread_cond_destroy(&qnotempty);
+		pthread_cond_destroy(&qnotfull);
+	}
+#endif
+	return (0);
+}
@@ -63,14 +63,17 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
-	if (parse_counter_args(&ac, &av) || ac != 4) {
-		fprintf(stderr, "Usage: %s%s iterations dummy -s OR"
-		   "\n       %s%s iterations [tcp|udp] [-]serverhost\n",
-		    av[0], counter_argstring, av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 4) {
+		fprintf(stderr, "Usage: %s%s%s iterations dummy -s OR"
+		   "\n       %s%s%s iterations [tcp|udp] [-]serverhost\n",
+		    av[0], counter_argstring, repeat_argstring,
+		    av[0], counter_argstring, repeat_argstring);
 		exit(1);
 	}
 
@@ -119,9 +122,11 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_client(niter, &totaltime);	/* get TCP latency */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		do_client(niter, &totaltime);	/* get TCP latency */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 	
 	return (0);
 }
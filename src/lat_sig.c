@@ -53,6 +53,7 @@ main(ac, av)
 	char **av;
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 	int 		(*fn)();
 
@@ -60,9 +61,10 @@ main(ac, av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "usage: %s%s iterations [install|handle]\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || ac != 3) {
+		fprintf(stderr, "usage: %s%s%s%s iterations [install|handle]\n",
+			av[0], counter_argstring, repeat_argstring, sample_argstring);
 		exit(1);
 	}
 
@@ -97,9 +99,12 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	(*fn)(niter, &totaltime);	/* get latency */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		(*fn)(niter, &totaltime);	/* get latency */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -144,6 +149,7 @@ do_install(num_iter, t)
 		sa.sa_flags = 0;		/* don't care */
 		sigaction(SIGUSR1, &sa, &old);
 		sigaction(SIGUSR1, &old, 0);
+		sample_op(2);
 	}
 	*t = stop(NULL);
 
@@ -179,14 +185,18 @@ do_handle(num_iter, t)
 	overhead = stop(NULL);
 
 	/*
-	 * Now make the real measurement
+	 * Now make the real measurement; samples are discounted by the
+	 * average null-signal cost, just like the total.
 	 */
+	sample_bias = overhead / num_iter;
 	start();
 	for (i = num_iter; i > 0; i--) {
 		kill(me, SIGUSR1);
+		sample_op(1);
 	}
 	*t = stop(NULL);
 	*t -= overhead;
+	sample_bias = 0;
 
 	return (0);
 }
@@ -68,6 +68,7 @@ int
 main(int ac, char **av)
 {
 	clk_t		totaltime;
+	int		run;
 	unsigned int	niter;
 	char *		scname;
 	int 		(*scfunc)(int, clk_t *);
@@ -76,10 +77,11 @@ main(int ac, char **av)
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations "
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || ac != 3) {
+		fprintf(stderr, "Usage: %s%s%s%s iterations "
 			"[sigaction | gettimeofday | sbrk | getrusage | write | getpid]\n",
-			av[0], counter_argstring);
+			av[0], counter_argstring, repeat_argstring, sample_argstring);
 		exit(1);
 	}
 
@@ -140,9 +142,12 @@ main(int ac, char **av)
 #else
 	niter = 1;
 #endif
-	(*scfunc)(niter, &totaltime);	/* get cached reread */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		(*scfunc)(niter, &totaltime);	/* get cached reread */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -164,6 +169,7 @@ do_writedevnull(num_iter, t)
 			perror("/dev/null");
 			exit(1);
 		}
+		sample_op(1);
 	}
 	*t = stop((void *)(long)c);
 
@@ -209,6 +215,7 @@ do_sigaction(int num_iter, clk_t *t)
 	for (i = num_iter/2; i > 0; i--) { /* each loop does 2 installations */
 		sigaction(SIGUSR1, &sa, &old);
 		sigaction(SIGUSR1, &old, 0);
+		sample_op(2);
 	}
 	*t = stop(NULL);
 
@@ -227,6 +234,7 @@ do_gettimeofday(int num_iter, clk_t *t)
 	start();
 	for (i = num_iter; i > 0; i--) {
 		gettimeofday(&tv, NULL);
+		sample_op(1);
 	}
 	*t = stop(&tv);
 
@@ -247,6 +255,7 @@ do_sbrk(num_iter, t)
 	start();
 	for (i = num_iter; i > 0; i--) {
 		brkval = sbrk(0);
+		sample_op(1);
 	}
 	*t = stop(brkval);
 
@@ -268,6 +277,7 @@ do_getrusage(num_iter, t)
 	start();
 	for (i = num_iter; i > 0; i--) {
 		getrusage(RUSAGE_SELF, &ru);
+		sample_op(1);
 	}
 	*t = stop(&ru);
 
@@ -289,6 +299,7 @@ do_getpid(num_iter, t)
 	start();
 	for (i = num_iter; i > 0; i--) {
 		p += getpid();
+		sample_op(1);
 	}
 	*t = stop((void *)(long)p);
 
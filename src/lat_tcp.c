@@ -64,15 +64,18 @@ main(ac, av)
 {
 	unsigned int	niter;
 	clk_t		totaltime;
+	int		run;
 
 	/* print out RCS ID to stderr*/
 	fprintf(stderr, "%s", id);
 
 	/* Check command-line arguments */
-	if (parse_counter_args(&ac, &av) || ac != 3) {
-		fprintf(stderr, "Usage: %s%s iterations -s OR"
-		   "\n       %s%s iterations [-]serverhost\n",
-		    av[0], counter_argstring, av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || ac != 3) {
+		fprintf(stderr, "Usage: %s%s%s%s iterations -s OR"
+		   "\n       %s%s%s%s iterations [-]serverhost\n",
+		    av[0], counter_argstring, repeat_argstring, sample_argstring,
+		    av[0], counter_argstring, repeat_argstring, sample_argstring);
 		exit(1);
 	}
 
@@ -120,9 +123,12 @@ main(ac, av)
 #else
 	niter = 1;
 #endif
-	do_client(niter, &totaltime);	/* get TCP latency */
-
-	output_latency(totaltime, niter);
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_client(niter, &totaltime);	/* get TCP latency */
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
 
 	return (0);
 }
@@ -165,6 +171,7 @@ do_client(num_iter, t)
 	for (i = num_iter; i > 0; i--) {
 		write(sock, &c, 1);
 		read(sock, &c, 1);
+		sample_op(1);
 	}
 	*t = stop(NULL);
 
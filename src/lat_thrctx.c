@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_thrctx.c - measures thread-to-thread context switch latency
+ *
+ * usage: lat_thrctx niter pipe|eventfd|futex|sem #threads same|spread
+ *
+ * Like lat_ctx, but the token is passed around a ring of threads in one
+ * process, so no switch changes address space. Each thread waits for the
+ * token on its own slot (see lib_wake.c) and then posts it to the next
+ * thread's slot. With "same" every thread is pinned to one CPU, so each
+ * hop is a real switch on that CPU; with "spread" the threads are pinned
+ * round-robin to the CPUs the process may run on, so each hop is a
+ * cross-CPU wakeup instead.
+ *
+ * As in lat_ctx, the cost of posting and taking the token within one
+ * thread is measured separately and subtracted.
+ */
+char	*id = "$Id$\n";
+
+#include "common.c"
+#include "lib_thread.c"
+#include "lib_wake.c"
+
+#define OVERHEADAVG_LOOPS	20
+#define OVERHEADAVG_TAILS	0.2
+
+/* Worker functions */
+int 	do_ctxsw();
+int 	do_overhead1();
+int 	do_overhead2();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int	ring_niter;			/* trips around the ring */
+struct wake_slot slots[MAX_THREADS];	/* one per thread */
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	clk_t		totaltime, overhead;
+	int		run, i;
+	unsigned int	niter, tmp;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    ac != 5) {
+		fprintf(stderr, "usage: %s%s%s iterations %s nthreads "
+			"same|spread\n", av[0], counter_argstring,
+			repeat_argstring, wake_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (parse_wake_mech(av[2])) {
+		fprintf(stderr, "%s: unknown or unsupported mechanism %s\n",
+			av[0], av[2]);
+		exit(1);
+	}
+	nthreads = atoi(av[3]);
+	if (nthreads < 2 || nthreads > MAX_THREADS) {
+		fprintf(stderr, "%s: need 2 to %d threads\n", av[0],
+			MAX_THREADS);
+		exit(1);
+	}
+#ifdef NO_THREADS
+	fprintf(stderr, "%s: threads not supported on this system\n", av[0]);
+	exit(1);
+#endif
+
+	/* Place the threads; thread 0 is the main thread */
+	if (!strcmp(av[4], "same")) {
+		i = nthreads;
+		nthreads = 1;
+		default_cpulist();
+		for (nthreads = i, i = 1; i < nthreads; i++)
+			thread_cpu[i] = thread_cpu[0];
+	} else if (!strcmp(av[4], "spread")) {
+		default_cpulist();
+	} else {
+		fprintf(stderr, "%s: placement must be same or spread\n",
+			av[0]);
+		exit(1);
+	}
+	thread_pin(thread_cpu[0]);
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+#ifndef COLD_CACHE
+	if (niter == 0) {
+		/*
+		 * Now we need to determine how many iterations of context
+		 * switching are necessary to make up one second.
+		 */
+		niter = gen_iterations(&do_ctxsw, clock_multiplier);
+
+		/* Now we output the result */
+		printf("%d\n", niter);
+		return (0);
+	}
+#else
+	niter = 1;
+#endif
+
+#ifdef NOOVERHEAD		/* for internal use only! */
+	overhead = 0;
+#else
+	/*
+	 * Measure the overhead of passing the token through all the slots
+	 * in a single thread, as lat_ctx does with its pipes.
+	 */
+	tmp = gen_iterations(&do_overhead1, clock_multiplier);
+
+	/* Use only 1/2 second to make running time reasonable */
+	tmp >>= 1;
+	do_overhead2(tmp, &overhead);
+#endif
+
+	/*
+	 * We know the overhead and the number of iterations; take the real
+	 * data.
+	 */
+#ifndef COLD_CACHE
+	do_ctxsw(1, &totaltime);		/* prime caches */
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		do_ctxsw(niter, &totaltime);		/* get total ctxsw time */
+		totaltime -= overhead * (clk_t)(niter*nthreads);
+		output_latency(totaltime, niter*nthreads);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+/*
+ * Worker function #1: measures time to pass a token through all nthreads
+ * slots in a single thread, without any switches.
+ *
+ * The time returned is the time for num_iter trips through the slots, so
+ * the overhead for 1 context switch is *t/(num_iter*nthreads).
+ */
+int
+do_overhead1(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	int	i, k;
+
+	wake_init(slots, nthreads);
+	start();
+	for (i = num_iter; i > 0; i--) {
+		for (k = 0; k < nthreads; k++) {
+			wake_post(&slots[k]);
+			wake_wait(&slots[k]);
+		}
+	}
+	*t = stop(NULL);
+	wake_done(slots, nthreads);
+
+	return (0);
+}
+
+/*
+ * Worker function #2: gathers the average of the middle 16 values of 20
+ * iterations of do_overhead1().
+ */
+int
+do_overhead2(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	int 	i;
+	clk_t	val;
+
+	centeravg_reset(OVERHEADAVG_LOOPS, OVERHEADAVG_TAILS);
+
+	for (i = OVERHEADAVG_LOOPS; i > 0; i--) {
+		do_overhead1(num_iter, &val);
+		centeravg_add(val/(nthreads*num_iter)); /* get 1-sw overhead */
+	}
+
+	centeravg_done(t);
+
+	return (0);
+}
+
+#ifndef NO_THREADS
+/*
+ * Worker function #3: the code run by each thread in the ring. It goes
+ * around once more than the main thread times, for the priming trip.
+ */
+void *
+ring_thread(arg)
+	void *arg;
+{
+	int	id = (int)(long)arg;
+	int	next = (id + 1) % nthreads;
+	int	i;
+
+	thread_pin(thread_cpu[id]);
+	for (i = ring_niter + 1; i > 0; i--) {
+		wake_wait(&slots[id]);
+		wake_post(&slots[next]);
+	}
+	return (NULL);
+}
+
+/*
+ * Worker function #4: does the actual context switch test.
+ *
+ * *t gets the time for num_iter trips through all the threads.
+ */
+int
+do_ctxsw(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	pthread_t	tid[MAX_THREADS];
+	int		i;
+
+	ring_niter = num_iter;
+	wake_init(slots, nthreads);
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&tid[i], NULL, ring_thread,
+				   (void *)(long)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	/*
+	 * Go once around the ring to make sure that everyone is ready.
+	 */
+	wake_post(&slots[1]);
+	wake_wait(&slots[0]);
+
+	start();
+	for (i = num_iter; i > 0; i--) {
+		wake_post(&slots[1]);
+		wake_wait(&slots[0]);
+	}
+	*t = stop(NULL);
+
+	for (i = 1; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+	wake_done(slots, nthreads);
+	return (0);
+}
+#else /* NO_THREADS */
+int
+do_ctxsw(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	*t = 0;
+	return (0);
+}
+#endif /* NO_THREADS */
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_unix.c - AF_UNIX socket transaction latency benchmark
+ *
+ * Usage: lat_unix iterations stream|seqpacket|dgram|fdpass
+ *		   [msgsize [sockbuf]]
+ *
+ * Like lat_pipe, but two processes bounce a msgsize-byte message
+ * (default 1) back and forth over a socketpair of the given type (see
+ * lib_unix.c). With "fdpass" the message is instead a descriptor passed
+ * with SCM_RIGHTS over a stream socket: each side receives the other's
+ * descriptor, closes it, and sends one of its own back. The descriptor
+ * is for /dev/null; passing sockets would also bring in the kernel's
+ * garbage collection of in-flight sockets. The msgsize for fdpass is 1.
+ *
+ * The send and receive buffers of both sockets are set to sockbuf bytes,
+ * as in bw_unix; the default, 0, leaves the system default.
+ */
+char	*id = "$Id$\n";
+
+#include <sys/wait.h>
+#include <fcntl.h>
+
+#include "common.c"
+#include "lib_unix.c"
+
+/* Worker function */
+int do_unix();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int		socktype;	/* SOCK_STREAM etc. */
+int		fdpass;		/* pass descriptors rather than data */
+unsigned int	msgsize = 1;	/* bytes per message */
+int		passfd = -1;	/* fdpass: what to send */
+int		sockbuf = 0;	/* socket buffer size; 0 for the default */
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	clk_t		totaltime;
+	int		run;
+	unsigned int	niter;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || ac < 3 || ac > 5) {
+		fprintf(stderr, "usage: %s%s%s%s iterations %s|fdpass "
+			"[msgsize [sockbuf]]\n", av[0], counter_argstring,
+			repeat_argstring, sample_argstring, unix_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (!strcmp(av[2], "fdpass")) {
+		fdpass = 1;
+		socktype = SOCK_STREAM;
+	} else if ((socktype = parse_unix_type(av[2])) == -1) {
+		fprintf(stderr, "%s: unknown or unsupported socket type %s\n",
+			av[0], av[2]);
+		exit(1);
+	}
+	if (ac >= 4) {
+		msgsize = parse_bytes(av[3]);
+		if (msgsize < 1 || (fdpass && msgsize != 1)) {
+			fprintf(stderr, "%s: bad message size\n", av[0]);
+			exit(1);
+		}
+	}
+	if (ac == 5)
+		sockbuf = parse_bytes(av[4]);
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+#ifndef COLD_CACHE
+	/*
+	 * Generate the appropriate number of iterations so the test takes
+	 * at least one second.
+	 */
+	if (niter == 0) {
+		niter = gen_iterations(&do_unix, clock_multiplier);
+		printf("%d\n",niter);
+		return (0);
+	}
+
+	/*
+	 * Take the real data and average to get a result
+	 */
+	do_unix(1, &totaltime);	/* prime caches, etc. */
+#else
+	niter = 1;
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_unix(niter, &totaltime);
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+/*
+ * Move one message over sock in the given direction, exiting on failure.
+ * A stream socket may split a message, so keep going until it is all
+ * there.
+ */
+void
+xfer(sock, buf, out)
+	int sock, out;
+	char *buf;
+{
+	unsigned int	done;
+	int		n;
+
+	if (fdpass) {
+		if (out)
+			send_fd(sock, passfd);
+		else
+			close(recv_fd(sock));
+		return;
+	}
+	for (done = 0; done < msgsize; done += n) {
+		n = out ? write(sock, buf + done, msgsize - done) :
+			read(sock, buf + done, msgsize - done);
+		if (n <= 0) {
+			perror(out ? "write on socket" : "read on socket");
+			exit(1);
+		}
+	}
+}
+
+/*
+ * Worker function: does num_iter round trips through the socketpair
+ */
+int
+do_unix(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	int	sv[2];
+	int	i;
+	char	*buf;
+	int	pid;
+
+	/* messages go both ways, so both sockets need both buffers */
+	unix_pair(socktype, sv, 0);
+	unix_optimize(sv[0], SOCKOPT_RDWR, sockbuf);
+	unix_optimize(sv[1], SOCKOPT_RDWR, sockbuf);
+	if (fdpass && passfd == -1 &&
+	    (passfd = open("/dev/null", O_RDONLY)) == -1) {
+		perror("/dev/null");
+		exit(1);
+	}
+	if ((buf = (char *)malloc(msgsize)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	bzero(buf, msgsize);
+
+	pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid > 0) {		/* parent */
+		close(sv[1]);
+
+		/*
+		 * One time around to make sure both processes are started.
+		 */
+		xfer(sv[0], buf, 1);
+		xfer(sv[0], buf, 0);
+
+		/* Start timing */
+		start();
+		for (i = num_iter; i > 0; i--) {
+			xfer(sv[0], buf, 1);
+			xfer(sv[0], buf, 0);
+			sample_op(1);
+		}
+		*t = stop(NULL);
+
+		kill(pid, 15);
+		waitpid(pid, NULL, 0);
+		close(sv[0]);
+	} else {		/* child */
+		close(sv[0]);
+		for ( ;; ) {
+			xfer(sv[1], buf, 0);
+			xfer(sv[1], buf, 1);
+		}
+		exit(0);
+	}
+	free(buf);
+	return (0);
+}
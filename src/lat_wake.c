@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lat_wake.c - thread wakeup latency benchmark
+ *
+ * usage: lat_wake niter pipe|eventfd|futex|sem roundtrip|oneway same|cross
+ *
+ * Two threads wake each other through a pair of lib_wake.c slots. In
+ * "roundtrip" mode this is lat_pipe with threads and a choice of
+ * primitive: the result is the time for one wakeup there and one back.
+ * In "oneway" mode the waking thread reads the clock just before it
+ * posts, and the woken thread reads it again as soon as its wait
+ * returns; the result is the mean of those intervals, and percentiles
+ * of them are always printed, as with -H. This needs a clock that
+ * agrees between CPUs (the monotonic clock, or an invariant cycle
+ * counter).
+ *
+ * With "same" both threads are pinned to one CPU; with "cross" they are
+ * pinned to the first two CPUs the process may run on.
+ */
+char	*id = "$Id$\n";
+
+#include "common.c"
+#include "lib_thread.c"
+#include "lib_wake.c"
+
+/* Worker function */
+int do_wake();
+
+/*
+ * Global variables: these are the parameters required by the worker routine.
+ * We make them global to avoid portability problems with variable argument
+ * lists and the gen_iterations function
+ */
+int		oneway;			/* oneway rather than roundtrip */
+int		wake_niter;		/* iterations for the partner */
+struct wake_slot ping, pong;		/* main to partner, and back */
+volatile clk_t	wake_stamp;		/* clock when pong was posted */
+
+int
+main(ac, av)
+	int ac;
+	char **av;
+{
+	clk_t		totaltime;
+	int		run;
+	unsigned int	niter;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av) || parse_repeat_args(&ac, &av) ||
+	    parse_sample_args(&ac, &av) || ac != 5) {
+		fprintf(stderr, "usage: %s%s%s%s iterations %s "
+			"roundtrip|oneway same|cross\n", av[0],
+			counter_argstring, repeat_argstring, sample_argstring,
+			wake_argstring);
+		exit(1);
+	}
+
+	/* parse command line parameters */
+	niter = atoi(av[1]);
+	if (parse_wake_mech(av[2])) {
+		fprintf(stderr, "%s: unknown or unsupported mechanism %s\n",
+			av[0], av[2]);
+		exit(1);
+	}
+	if (!strcmp(av[3], "oneway")) {
+		oneway = 1;
+		if (sample_batch) {
+			fprintf(stderr, "%s: -H does not apply to oneway\n",
+				av[0]);
+			exit(1);
+		}
+	} else if (strcmp(av[3], "roundtrip")) {
+		fprintf(stderr, "%s: mode must be roundtrip or oneway\n",
+			av[0]);
+		exit(1);
+	}
+#ifdef NO_THREADS
+	fprintf(stderr, "%s: threads not supported on this system\n", av[0]);
+	exit(1);
+#endif
+
+	/* Place the threads; thread 0 is the main thread */
+	if (!strcmp(av[4], "same")) {
+		default_cpulist();		/* nthreads is 1 */
+		thread_cpu[1] = thread_cpu[0];
+	} else if (!strcmp(av[4], "cross")) {
+		nthreads = 2;
+		default_cpulist();
+	} else {
+		fprintf(stderr, "%s: placement must be same or cross\n",
+			av[0]);
+		exit(1);
+	}
+	nthreads = 2;
+	thread_pin(thread_cpu[0]);
+
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+#ifndef COLD_CACHE
+	/*
+	 * Generate the appropriate number of iterations so the test takes
+	 * at least one second.
+	 */
+	if (niter == 0) {
+		niter = gen_iterations(&do_wake, clock_multiplier);
+		printf("%d\n",niter);
+		return (0);
+	}
+
+	/*
+	 * Take the real data and average to get a result
+	 */
+	do_wake(1, &totaltime);	/* prime caches, etc. */
+#else
+	niter = 1;
+#endif
+	for (run = repeat_runs; run > 0; run--) {
+		latency_hist_reset();
+		do_wake(niter, &totaltime);
+		output_latency(totaltime, niter);
+	}
+	repeat_done();
+
+	return (0);
+}
+
+#ifndef NO_THREADS
+/*
+ * The partner thread: wait for ping, answer with pong. It goes around
+ * once more than the main thread times, to make sure both are running.
+ */
+void *
+partner(arg)
+	void *arg;
+{
+	int	i;
+
+	thread_pin(thread_cpu[1]);
+	for (i = wake_niter + 1; i > 0; i--) {
+		wake_wait(&ping);
+		if (oneway)
+			wake_stamp = read_clock();
+		wake_post(&pong);
+	}
+	return (NULL);
+}
+
+/*
+ * Worker function: does num_iter ping/pong exchanges. In oneway mode,
+ * *t is the sum of the pong wakeup times rather than the elapsed time.
+ */
+int
+do_wake(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	pthread_t	tid;
+	clk_t		d, sum = 0;
+	int		i;
+
+	wake_niter = num_iter;
+	wake_init(&ping, 1);
+	wake_init(&pong, 1);
+	if (pthread_create(&tid, NULL, partner, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+
+	/*
+	 * One time around to make sure both threads are started.
+	 */
+	wake_post(&ping);
+	wake_wait(&pong);
+
+	start();
+	for (i = num_iter; i > 0; i--) {
+		wake_post(&ping);
+		wake_wait(&pong);
+		if (oneway) {
+			d = read_clock() - wake_stamp;
+			sum += d;
+			latency_hist_add(d);
+		} else
+			sample_op(1);
+	}
+	*t = stop(NULL);
+	if (oneway)
+		*t = sum;
+
+	pthread_join(tid, NULL);
+	wake_done(&ping, 1);
+	wake_done(&pong, 1);
+	return (0);
+}
+#else /* NO_THREADS */
+int
+do_wake(num_iter, t)
+	int num_iter;
+	clk_t *t;
+{
+	*t = 0;
+	return (0);
+}
+#endif /* NO_THREADS */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_memkern.c - named memory read/write/copy kernels for the
+ *                 bandwidth benchmarks
+ *
+ * bw_mem_rd, bw_mem_wr and bw_mem_cp accept a kernel name in addition
+ * to their own "unrolled" (and "libc") loops:
+ *
+ *	name	read		write		copy
+ *	sse2	16-byte loads	16-byte stores	16-byte loads/stores
+ *	avx2	32-byte		32-byte		32-byte
+ *	avx512	64-byte		64-byte		64-byte
+ *	movsb	-		rep stosb	rep movsb
+ *	nt	-		streaming	loads + streaming stores
+ *
+ * The kernels are only available on x86-64. memkern_lookup() returns
+ * NULL (after printing why) if the name is unknown, has no kernel for
+ * the operation, or the CPU lacks the needed instructions. Kernels move
+ * a multiple of MEMKERN_GRAN bytes; use memkern_bytes() to find how
+ * many bytes of a buffer they will touch.
+ */
+#ifndef __LIB_MEMKERN_C__
+#define __LIB_MEMKERN_C__
+
+#define MEMKERN_GRAN	256		/* four 64-byte vectors */
+
+#define MEMKERN_READ	0
+#define MEMKERN_WRITE	1
+#define MEMKERN_COPY	2
+
+struct memkern {
+	char	*name;
+	int	(*supported)(void);
+	unsigned long	(*rd)(void *buf, unsigned long n);
+	void	(*wr)(void *buf, unsigned long n);
+	void	(*cp)(void *dst, void *src, unsigned long n);
+};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include "arch/x86_64/memkernels.c"
+
+static struct memkern memkerns[] = {
+	{ "sse2",	has_sse2,	rd_sse2,	wr_sse2,	cp_sse2 },
+	{ "avx2",	has_avx2,	rd_avx2,	wr_avx2,	cp_avx2 },
+	{ "avx512",	has_avx512,	rd_avx512,	wr_avx512,	cp_avx512 },
+	{ "movsb",	has_any,	NULL,		wr_movsb,	cp_movsb },
+	{ "nt",		has_sse2,	NULL,		wr_nt,		cp_nt },
+	{ NULL }
+};
+#else
+static struct memkern memkerns[] = {
+	{ NULL }
+};
+#endif
+
+/*
+ * Find the kernel called name for operation op (MEMKERN_READ etc.)
+ */
+struct memkern *
+memkern_lookup(char *name, int op)
+{
+	struct memkern *k;
+
+	for (k = memkerns; k->name; k++) {
+		if (strcmp(k->name, name) != 0)
+			continue;
+		if ((op == MEMKERN_READ && !k->rd) ||
+		    (op == MEMKERN_WRITE && !k->wr) ||
+		    (op == MEMKERN_COPY && !k->cp)) {
+			fprintf(stderr, "error: no %s kernel for this test\n",
+				name);
+			return (NULL);
+		}
+		if (!(*k->supported)()) {
+			fprintf(stderr, "error: this CPU does not support "
+				"%s\n", name);
+			return (NULL);
+		}
+		return (k);
+	}
+	fprintf(stderr, "error: unknown kernel %s\n", name);
+	return (NULL);
+}
+
+/*
+ * Bytes of a buffer of the given size that a kernel moves
+ */
+unsigned int
+memkern_bytes(unsigned int bytes)
+{
+	return (bytes & ~(MEMKERN_GRAN - 1));
+}
+
+#endif /* __LIB_MEMKERN_C__ */
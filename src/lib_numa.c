@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_numa.c - NUMA placement for the memory benchmarks
+ *
+ * A benchmark that includes this file accepts "-n cpunode" and
+ * "-m memnode". -n restricts the process to the CPUs of one node as
+ * soon as it is parsed, so it should be parsed before any option (like
+ * -t) that picks CPUs from the process's affinity mask. -m binds all
+ * later allocations to one node with set_mempolicy(); numa_bind_mem()
+ * additionally mbind()s (and migrates) a buffer that may already have
+ * been touched, and numa_check() reports where a buffer really landed.
+ *
+ * Running each benchmark for every (cpunode, memnode) pair gives a
+ * node-to-node matrix; see scripts/numa-matrix.
+ *
+ * The system calls are made directly so that no libnuma is needed.
+ * On systems other than Linux the options are rejected.
+ */
+#ifndef __LIB_NUMA_C__
+#define __LIB_NUMA_C__
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+#define NUMA_MAXNODE	1024
+#define NUMA_MPOL_BIND	2		/* MPOL_BIND */
+#define NUMA_MF_MOVE	(1<<1)		/* MPOL_MF_MOVE */
+
+static char *numa_argstring = " [-n cpunode] [-m memnode]";
+
+int	numa_cpunode = -1;		/* node to run on, or -1 */
+int	numa_memnode = -1;		/* node to allocate on, or -1 */
+
+#ifdef __linux__
+static unsigned long numa_mask[NUMA_MAXNODE / (8 * sizeof(long))];
+
+/*
+ * Restrict the process to the CPUs listed in
+ * /sys/devices/system/node/node<N>/cpulist, e.g. "0-7,16-23".
+ */
+static int
+numa_bind_cpu(int node)
+{
+	char fname[64], buf[1024], *s, *end;
+	cpu_set_t set;
+	int lo, hi, n, fd;
+
+	sprintf(fname, "/sys/devices/system/node/node%d/cpulist", node);
+	if ((fd = open(fname, O_RDONLY)) == -1 ||
+	    (n = read(fd, buf, sizeof(buf) - 1)) <= 0) {
+		fprintf(stderr, "-n: no such node %d\n", node);
+		return (1);
+	}
+	close(fd);
+	buf[n] = '\0';
+
+	CPU_ZERO(&set);
+	for (s = buf; *s && *s != '\n'; ) {
+		lo = hi = (int)strtol(s, &end, 10);
+		if (end == s)
+			break;
+		if (*end == '-')
+			hi = (int)strtol(end + 1, &end, 10);
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+			CPU_SET(lo, &set);
+		s = (*end == ',') ? end + 1 : end;
+	}
+	if (CPU_COUNT(&set) == 0) {
+		fprintf(stderr, "-n: node %d has no CPUs\n", node);
+		return (1);
+	}
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		perror("sched_setaffinity");
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * Make all further allocations of this process come from one node.
+ */
+static int
+numa_set_mem(int node)
+{
+	numa_mask[node / (8 * sizeof(long))] |= 1UL << (node % (8 * sizeof(long)));
+	if (syscall(SYS_set_mempolicy, NUMA_MPOL_BIND, numa_mask,
+		    NUMA_MAXNODE + 1) != 0) {
+		perror("set_mempolicy");
+		return (1);
+	}
+	return (0);
+}
+#endif /* __linux__ */
+
+/*
+ * Parse the NUMA options; like parse_counter_args, they are consumed
+ * and av[0] is left in place. Returns 0 on success, 1 on error.
+ */
+int
+parse_numa_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+	char *opt;
+	int node;
+
+	while (*acp >= 3 && (!strcmp((*avp)[1], "-n") ||
+			     !strcmp((*avp)[1], "-m"))) {
+		opt = (*avp)[1];
+		node = atoi((*avp)[2]);
+		if (node < 0 || node >= NUMA_MAXNODE)
+			return (1);
+#ifdef __linux__
+		if (opt[1] == 'n') {
+			if (numa_bind_cpu(node))
+				return (1);
+			numa_cpunode = node;
+		} else {
+			if (numa_set_mem(node))
+				return (1);
+			numa_memnode = node;
+		}
+#else
+		fprintf(stderr, "%s: NUMA placement not supported on this "
+			"system\n", opt);
+		return (1);
+#endif
+		*acp -= 2;
+		*avp += 2;
+		(*avp)[0] = av0;
+	}
+	return (0);
+}
+
+/*
+ * Bind a buffer to the -m node, moving any pages already touched.
+ */
+void
+numa_bind_mem(void *addr, unsigned long len)
+{
+#ifdef __linux__
+	unsigned long pg = getpagesize();
+	unsigned long start = (unsigned long)addr & ~(pg - 1);
+
+	if (numa_memnode < 0)
+		return;
+	len += (unsigned long)addr - start;
+	if (syscall(SYS_mbind, start, len, NUMA_MPOL_BIND, numa_mask,
+		    NUMA_MAXNODE + 1, NUMA_MF_MOVE) != 0)
+		perror("mbind");
+#endif
+}
+
+/*
+ * Warn if the (touched) page at addr is not on the -m node.
+ */
+void
+numa_check(void *addr, char *what)
+{
+#ifdef __linux__
+	void *page = (void *)((unsigned long)addr & ~(getpagesize() - 1UL));
+	int status = -1;
+
+	if (numa_memnode < 0)
+		return;
+	if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) == 0 &&
+	    status != numa_memnode)
+		fprintf(stderr, "warning: %s is on node %d, not node %d\n",
+			what, status, numa_memnode);
+#endif
+}
+
+#endif /* __LIB_NUMA_C__ */
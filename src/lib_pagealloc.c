@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_pagealloc.c - page size policy for the memory benchmarks
+ *
+ * A benchmark that includes this file accepts "-P policy" and gets its
+ * buffers from page_alloc()/page_free(). The policies are:
+ *
+ *	(none)	valloc(), i.e. whatever the system does by default
+ *	4k	base pages only (MADV_NOHUGEPAGE)
+ *	thp	transparent huge pages (2MB-aligned, MADV_HUGEPAGE)
+ *	2m	explicit 2MB pages (MAP_HUGETLB)
+ *	1g	explicit 1GB pages (MAP_HUGETLB)
+ *
+ * The explicit policies need pages reserved beforehand, e.g. through
+ * /sys/kernel/mm/hugepages/hugepages-2048kB/nr_hugepages; page_alloc()
+ * returns NULL if there are not enough. page_advise() applies the
+ * 4k/thp policies to a mapping made elsewhere (e.g. of a file); the
+ * explicit policies only apply to files on a hugetlbfs file system.
+ * page_size is the size of the pages the policy asks for.
+ */
+#ifndef __LIB_PAGEALLOC_C__
+#define __LIB_PAGEALLOC_C__
+
+#include <sys/mman.h>
+
+#define PAGE_DEFAULT	0
+#define PAGE_4K		1
+#define PAGE_THP	2
+#define PAGE_2M		3
+#define PAGE_1G		4
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_SHIFT	26
+#endif
+
+static char *page_argstring = " [-P 4k|thp|2m|1g]";
+
+int		page_policy = PAGE_DEFAULT;
+unsigned long	page_size;
+
+/*
+ * Select a policy and set page_size to match.
+ */
+void
+page_setup(int policy)
+{
+	page_policy = policy;
+	switch (policy) {
+	case PAGE_THP:
+	case PAGE_2M:
+		page_size = 2UL*1024*1024;
+		break;
+	case PAGE_1G:
+		page_size = 1024UL*1024*1024;
+		break;
+	default:
+		page_size = getpagesize();
+		break;
+	}
+}
+
+/*
+ * Parse the page policy option; like parse_counter_args, it is consumed
+ * and av[0] is left in place. Returns 0 on success, 1 on error.
+ */
+int
+parse_page_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+	char *s;
+
+	page_setup(PAGE_DEFAULT);
+	if (*acp >= 3 && !strcmp((*avp)[1], "-P")) {
+		s = (*avp)[2];
+		if (!strcmp(s, "4k"))
+			page_setup(PAGE_4K);
+		else if (!strcmp(s, "thp"))
+			page_setup(PAGE_THP);
+		else if (!strcmp(s, "2m"))
+			page_setup(PAGE_2M);
+		else if (!strcmp(s, "1g"))
+			page_setup(PAGE_1G);
+		else
+			return (1);
+#ifndef MAP_HUGETLB
+		if (page_policy == PAGE_2M || page_policy == PAGE_1G) {
+			fprintf(stderr, "-P %s: not supported on this system\n",
+				s);
+			return (1);
+		}
+#endif
+		*acp -= 2;
+		*avp += 2;
+		(*avp)[0] = av0;
+	}
+	return (0);
+}
+
+/*
+ * Apply the 4k or thp policy to an existing mapping.
+ */
+void
+page_advise(void *p, unsigned long len)
+{
+#ifdef MADV_HUGEPAGE
+	if (page_policy == PAGE_THP && madvise(p, len, MADV_HUGEPAGE) != 0)
+		perror("madvise(MADV_HUGEPAGE)");
+	if (page_policy == PAGE_4K && madvise(p, len, MADV_NOHUGEPAGE) != 0)
+		perror("madvise(MADV_NOHUGEPAGE)");
+#endif
+}
+
+static unsigned long
+page_roundup(unsigned long len)
+{
+	return ((len + page_size - 1) & ~(page_size - 1));
+}
+
+/*
+ * Allocate len bytes under the current policy; NULL if we can't.
+ */
+void *
+page_alloc(unsigned long len)
+{
+	char *p, *a;
+	unsigned long rlen;
+	int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+
+	if (page_policy == PAGE_DEFAULT)
+		return (valloc(len));
+
+	rlen = page_roundup(len);
+#ifdef MAP_HUGETLB
+	if (page_policy == PAGE_2M)
+		flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+	if (page_policy == PAGE_1G)
+		flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+#endif
+	if (page_policy == PAGE_THP) {
+		/* Over-allocate, then trim to a 2MB-aligned region */
+		p = mmap(NULL, rlen + page_size, PROT_READ|PROT_WRITE,
+			 flags, -1, 0);
+		if (p == MAP_FAILED)
+			return (NULL);
+		a = (char *)(((unsigned long)p + page_size - 1) &
+			     ~(page_size - 1));
+		if (a > p)
+			munmap(p, a - p);
+		munmap(a + rlen, (p + rlen + page_size) - (a + rlen));
+	} else {
+		a = mmap(NULL, rlen, PROT_READ|PROT_WRITE, flags, -1, 0);
+		if (a == MAP_FAILED)
+			return (NULL);
+	}
+	page_advise(a, rlen);
+	return (a);
+}
+
+/*
+ * Free memory from page_alloc(len)
+ */
+void
+page_free(void *p, unsigned long len)
+{
+	if (page_policy == PAGE_DEFAULT)
+		free(p);
+	else
+		munmap(p, page_roundup(len));
+}
+
+#endif /* __LIB_PAGEALLOC_C__ */
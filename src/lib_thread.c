@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_thread.c - support for benchmarks that run a worker in several
+ *                threads at once
+ *
+ * A benchmark that includes this file accepts "-t threads" (and
+ * optionally "-C cpulist", e.g. "0,2,8-15") after its other harness
+ * options, and sets "threaded". thread_run() then starts one thread per
+ * CPU in the list, each pinned to its CPU. Every worker brackets the
+ * measured work with thread_begin() and thread_end(), which wait for the
+ * rest of the team and read the clock:
+ *
+ *	worker(id, num_iter):
+ *			set up (allocate, touch memory)
+ *			thread_begin(id);
+ *			... the measured work ...
+ *			thread_end(id);
+ *			clean up
+ *
+ * thread_time[] holds each thread's own time. The time returned by
+ * thread_run() is the wall time for the whole team, from the first
+ * thread's start to the last one's end; it is taken from the workers'
+ * clocks rather than the main thread's, which is not pinned and may
+ * wait behind them for a CPU. The event counters are started and
+ * stopped by the main thread.
+ *
+ * On Linux, CPU affinity needs _GNU_SOURCE, which the Makefile defines.
+ * Build with -DNO_THREADS on systems without POSIX threads.
+ */
+#ifndef __LIB_THREAD_C__
+#define __LIB_THREAD_C__
+
+#ifndef NO_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define MAX_THREADS	256
+
+static char *thread_argstring = " [-t threads [-C cpulist]]";
+
+int	threaded = 0;			/* -t given */
+int	nthreads = 1;			/* number of worker threads */
+int	thread_cpu[MAX_THREADS];	/* CPU each thread is pinned to */
+clk_t	thread_time[MAX_THREADS];	/* each thread's measured time */
+clk_t	thread_t0[MAX_THREADS];		/* clock when each thread began */
+clk_t	thread_t1[MAX_THREADS];		/* and when it ended */
+
+#ifndef NO_THREADS
+static pthread_barrier_t thread_barrier;
+static void (*thread_worker)(int, int);
+static int thread_niter;
+#endif
+
+/*
+ * Parse a list of CPUs like "0,2,8-15" into thread_cpu[]; return the
+ * number of CPUs listed.
+ */
+static int
+parse_cpulist(char *s)
+{
+	int n = 0, lo, hi;
+	char *end;
+
+	while (*s && n < MAX_THREADS) {
+		lo = hi = (int)strtol(s, &end, 10);
+		if (end == s)
+			return (0);
+		if (*end == '-')
+			hi = (int)strtol(end + 1, &end, 10);
+		for (; lo <= hi && n < MAX_THREADS; lo++)
+			thread_cpu[n++] = lo;
+		s = (*end == ',') ? end + 1 : end;
+	}
+	return (n);
+}
+
+/*
+ * Default CPU list: the CPUs this process is allowed to run on, in
+ * order, repeated if there are more threads than CPUs. Returns the
+ * number of CPUs, or 0 if they are unknown.
+ */
+static int
+default_cpulist()
+{
+	int i, n = 0;
+#if !defined(NO_THREADS) && defined(__linux__)
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (i = 0; i < CPU_SETSIZE && n < MAX_THREADS; i++)
+			if (CPU_ISSET(i, &set))
+				thread_cpu[n++] = i;
+	}
+#endif
+	if (n == 0) {
+		for (i = 0; i < nthreads; i++)
+			thread_cpu[i] = -1;	/* don't pin */
+		return (0);
+	}
+	if (n < nthreads)
+		fprintf(stderr, "warning: %d threads on %d CPUs\n",
+			nthreads, n);
+	for (i = n; i < nthreads; i++)
+		thread_cpu[i] = thread_cpu[i - n];
+	return (n);
+}
+
+/*
+ * Parse the thread options; like parse_counter_args, they are consumed
+ * and av[0] is left in place. Returns 0 on success, 1 on error.
+ */
+int
+parse_thread_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+	int ncpus = 0;
+
+	if (*acp >= 3 && !strcmp((*avp)[1], "-t")) {
+		nthreads = atoi((*avp)[2]);
+		if (nthreads < 1 || nthreads > MAX_THREADS)
+			return (1);
+		threaded = 1;
+#ifdef NO_THREADS
+		if (nthreads > 1) {
+			fprintf(stderr, "threads not supported on this "
+				"system\n");
+			return (1);
+		}
+#endif
+		*acp -= 2;
+		*avp += 2;
+		if (*acp >= 3 && !strcmp((*avp)[1], "-C")) {
+			ncpus = parse_cpulist((*avp)[2]);
+			if (ncpus < nthreads) {
+				fprintf(stderr, "-C: need at least %d CPUs\n",
+					nthreads);
+				return (1);
+			}
+			*acp -= 2;
+			*avp += 2;
+		}
+		(*avp)[0] = av0;
+	}
+	if (ncpus == 0)
+		default_cpulist();
+	return (0);
+}
+
+/*
+ * Pin the calling thread to a CPU; -1 means leave it alone.
+ */
+void
+thread_pin(int cpu)
+{
+#if !defined(NO_THREADS) && defined(__linux__)
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		perror("sched_setaffinity");
+		exit(1);
+	}
+#endif
+}
+
+/*
+ * The team's time: from the earliest thread_t0[] to the latest
+ * thread_t1[]. Clock readings are compared by their differences, which
+ * are correct even if clk_t wraps.
+ */
+static clk_t
+thread_team_time()
+{
+	clk_t first = thread_t0[0], t, team = 0;
+	int i;
+
+	for (i = 1; i < nthreads; i++)
+		if ((clk_t)(first - thread_t0[i]) <
+		    (clk_t)(thread_t0[i] - first))
+			first = thread_t0[i];
+	for (i = 0; i < nthreads; i++)
+		if ((t = thread_t1[i] - first) > team)
+			team = t;
+	return (team);
+}
+
+#ifndef NO_THREADS
+/*
+ * Wait until all the workers and the main thread get here.
+ */
+void
+thread_sync()
+{
+	pthread_barrier_wait(&thread_barrier);
+}
+
+static void *
+thread_start(void *arg)
+{
+	int id = (int)(long)arg;
+
+	thread_pin(thread_cpu[id]);
+	(*thread_worker)(id, thread_niter);
+	return (NULL);
+}
+
+/*
+ * Run worker(0..nthreads-1, num_iter) in nthreads pinned threads; return
+ * the team's time in *t.
+ */
+void
+thread_run(void (*worker)(int, int), int num_iter, clk_t *t)
+{
+	pthread_t tid[MAX_THREADS];
+	int i;
+
+	thread_worker = worker;
+	thread_niter = num_iter;
+	pthread_barrier_init(&thread_barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&tid[i], NULL, thread_start,
+				   (void *)(long)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	thread_sync();		/* all set up */
+	start();		/* for the event counters */
+	thread_sync();		/* all done */
+	stop(NULL);
+	*t = thread_team_time();
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+	pthread_barrier_destroy(&thread_barrier);
+}
+#else /* NO_THREADS */
+/*
+ * Without threads, -t 1 runs the worker in the calling thread.
+ */
+void
+thread_sync()
+{
+}
+
+void
+thread_run(void (*worker)(int, int), int num_iter, clk_t *t)
+{
+	thread_pin(thread_cpu[0]);
+	(*worker)(0, num_iter);
+	*t = thread_time[0];
+}
+#endif /* NO_THREADS */
+
+/*
+ * Start and end the measured work of thread id
+ */
+void
+thread_begin(int id)
+{
+	thread_sync();		/* all set up */
+	thread_t0[id] = read_clock();
+}
+
+void
+thread_end(int id)
+{
+	thread_t1[id] = read_clock();
+	thread_time[id] = thread_t1[id] - thread_t0[id];
+	thread_sync();		/* all done */
+}
+
+/*
+ * Output aggregate bandwidth for the team (bytes is per thread), then
+ * each thread's own bandwidth, then any recorded latency percentiles.
+ */
+void
+output_thread_bandwidth(double bytes, clk_t ticks)
+{
+	int i;
+
+	repeat_record(ticks, bytes * nthreads, REPEAT_BANDWIDTH);
+	print_bandwidth(bytes * nthreads, ticks);
+	for (i = 0; i < nthreads; i++) {
+		printf(" ");
+		print_bandwidth(bytes, thread_time[i]);
+	}
+	print_latency_pcts();
+	output_bandwidth_tail(bytes * nthreads);
+}
+
+/*
+ * Output the operations per second of the team (ops is per thread),
+ * then each thread's own. With -r the trimmed mean is the time per
+ * operation of the team, in microseconds.
+ */
+void
+output_thread_rate(double ops, clk_t ticks)
+{
+	int i;
+
+	repeat_record(ticks, ops * nthreads, REPEAT_LATENCY);
+	printf("%.0f", ticks > 0 ? ops * nthreads /
+	       ((double)ticks * clock_multiplier / 1000000.0) : 0.0);
+	for (i = 0; i < nthreads; i++)
+		printf(" %.0f", thread_time[i] > 0 ? ops /
+		       ((double)thread_time[i] * clock_multiplier /
+			1000000.0) : 0.0);
+	output_bandwidth_tail(ops * nthreads);
+}
+
+#endif /* __LIB_THREAD_C__ */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_unix.c - routines for the AF_UNIX socket benchmarks
+ *
+ * The benchmarks run both ends on one machine, so a socketpair() stands
+ * in for the server/connect dance of lib_tcp.c. The socket type is one of
+ *
+ *	stream		SOCK_STREAM, a byte stream like TCP
+ *	seqpacket	SOCK_SEQPACKET, connected and reliable, but with
+ *			message boundaries
+ *	dgram		SOCK_DGRAM, which never loses data on AF_UNIX; a
+ *			full receiver blocks the sender
+ */
+#ifndef __LIB_UNIX_C__
+#define __LIB_UNIX_C__
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+static char *unix_argstring = "stream|seqpacket|dgram";
+
+/*
+ * Map a type name to a socket type; returns -1 if it is unknown or not
+ * available on this system.
+ */
+int
+parse_unix_type(char *s)
+{
+	if (!strcmp(s, "stream"))
+		return (SOCK_STREAM);
+#ifdef SOCK_SEQPACKET
+	if (!strcmp(s, "seqpacket"))
+		return (SOCK_SEQPACKET);
+#endif
+	if (!strcmp(s, "dgram"))
+		return (SOCK_DGRAM);
+	return (-1);
+}
+
+/*
+ * Like sock_optimize() in lib_tcp.c, but with the buffer size as a
+ * parameter: ask for sockbuf bytes, stepping down until the system
+ * accepts. A sockbuf of 0 leaves the system default.
+ */
+void
+unix_optimize(int sock, int rdwr, int sockbuf)
+{
+	int	n;
+
+	if (sockbuf == 0)
+		return;
+	if (rdwr == SOCKOPT_READ || rdwr == SOCKOPT_RDWR) {
+		for (n = sockbuf; n > SOCKSTEP && setsockopt(sock, SOL_SOCKET,
+		    SO_RCVBUF, &n, sizeof(int)); n -= SOCKSTEP)
+			;
+	}
+	if (rdwr == SOCKOPT_WRITE || rdwr == SOCKOPT_RDWR) {
+		for (n = sockbuf; n > SOCKSTEP && setsockopt(sock, SOL_SOCKET,
+		    SO_SNDBUF, &n, sizeof(int)); n -= SOCKSTEP)
+			;
+	}
+}
+
+/*
+ * Make a connected pair of the given type. sv[0] is set up for writing
+ * and sv[1] for reading, each with a sockbuf-byte buffer.
+ */
+void
+unix_pair(int type, int sv[2], int sockbuf)
+{
+	if (socketpair(AF_UNIX, type, 0, sv) == -1) {
+		perror("socketpair");
+		exit(1);
+	}
+	unix_optimize(sv[0], SOCKOPT_WRITE, sockbuf);
+	unix_optimize(sv[1], SOCKOPT_READ, sockbuf);
+}
+
+/*
+ * Pass descriptor fd over sock with SCM_RIGHTS, along with one byte
+ */
+void
+send_fd(int sock, int fd)
+{
+	struct msghdr	msg;
+	struct iovec	iov;
+	struct cmsghdr	*cmsg;
+	union {
+		struct cmsghdr	hdr;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	} cbuf;
+	char		c = 0;
+
+	bzero((char *)&msg, sizeof(msg));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	bcopy((char *)&fd, (char *)CMSG_DATA(cmsg), sizeof(int));
+	if (sendmsg(sock, &msg, 0) != 1) {
+		perror("sendmsg");
+		exit(1);
+	}
+}
+
+/*
+ * Receive a descriptor sent by send_fd(); returns the new descriptor
+ */
+int
+recv_fd(int sock)
+{
+	struct msghdr	msg;
+	struct iovec	iov;
+	struct cmsghdr	*cmsg;
+	union {
+		struct cmsghdr	hdr;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	} cbuf;
+	char		c;
+	int		fd;
+
+	bzero((char *)&msg, sizeof(msg));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+	if (recvmsg(sock, &msg, 0) != 1) {
+		perror("recvmsg");
+		exit(1);
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS) {
+		fprintf(stderr, "recv_fd: no descriptor in message\n");
+		exit(1);
+	}
+	bcopy((char *)CMSG_DATA(cmsg), (char *)&fd, sizeof(int));
+	return (fd);
+}
+
+#endif /* __LIB_UNIX_C__ */
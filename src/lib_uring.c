@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_uring.c - a minimal io_uring interface for the I/O benchmarks
+ *
+ * A benchmark that includes this file accepts "-U depth[,buf][,file]
+ * [,sqpoll]" and, if it is given, issues its I/O through an io_uring
+ * with depth requests in flight instead of one synchronous call at a
+ * time. "buf" registers the benchmark's buffers with the kernel (so the
+ * requests become READ_FIXED/WRITE_FIXED), "file" registers its file
+ * descriptors, and "sqpoll" has a kernel thread poll the submission
+ * queue, so that submitting takes no system call.
+ *
+ * The ring is driven with the raw system calls; liburing is not needed.
+ * On systems without io_uring, parse_uring_args() rejects -U.
+ */
+#ifndef __LIB_URING_C__
+#define __LIB_URING_C__
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define HAVE_URING		/* IORING_OP_READ came with RW_CUR_POS */
+#endif
+#endif
+
+#define URING_BUF	1		/* registered buffers */
+#define URING_FILE	2		/* registered files */
+#define URING_SQPOLL	4		/* kernel submission thread */
+
+static char *uring_argstring = " [-U depth[,buf][,file][,sqpoll]]";
+
+int		uring_depth = 0;	/* 0: synchronous I/O */
+int		uring_flags = 0;	/* URING_* */
+
+/*
+ * Parse the io_uring option; like parse_counter_args, it is consumed and
+ * av[0] is left in place. Returns 0 on success, 1 on error.
+ */
+int
+parse_uring_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+	char *s;
+
+	if (*acp >= 3 && !strcmp((*avp)[1], "-U")) {
+#ifndef HAVE_URING
+		fprintf(stderr, "-U: io_uring not supported on this system\n");
+		return (1);
+#endif
+		s = (*avp)[2];
+		if ((uring_depth = atoi(s)) <= 0)
+			return (1);
+		while ((s = strchr(s, ',')) != NULL) {
+			s++;
+			if (!strncmp(s, "buf", 3))
+				uring_flags |= URING_BUF;
+			else if (!strncmp(s, "file", 4))
+				uring_flags |= URING_FILE;
+			else if (!strncmp(s, "sqpoll", 6))
+				uring_flags |= URING_SQPOLL;
+			else
+				return (1);
+		}
+		*acp -= 2;
+		*avp += 2;
+		(*avp)[0] = av0;
+	}
+	return (0);
+}
+
+#ifdef HAVE_URING
+/*
+ * One ring: the kernel's shared queues as mapped into our space
+ */
+struct uring {
+	int			fd;
+	unsigned		*sq_head, *sq_tail, *sq_mask, *sq_flags;
+	unsigned		*sq_array;
+	unsigned		*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+	unsigned		sq_local;	/* our tail, not yet published */
+	unsigned		to_submit;	/* prepared since last enter */
+};
+
+/*
+ * Set up r with room for depth requests, under uring_flags. Returns 0,
+ * or -1 with errno set if the kernel would not make the ring.
+ */
+int
+uring_init(struct uring *r, unsigned depth)
+{
+	struct io_uring_params	p;
+	char			*sq, *cq;
+	size_t			sqlen, cqlen;
+
+	bzero((char *)&p, sizeof(p));
+	if (uring_flags & URING_SQPOLL) {
+		p.flags |= IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = 1000;	/* ms */
+	}
+	if ((r->fd = syscall(__NR_io_uring_setup, depth, &p)) < 0)
+		return (-1);
+
+	sqlen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqlen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cqlen > sqlen)
+			sqlen = cqlen;
+		cqlen = sqlen;
+	}
+	sq = mmap(NULL, sqlen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		  r->fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		return (-1);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cq = sq;
+	else {
+		cq = mmap(NULL, cqlen, PROT_READ|PROT_WRITE,
+			  MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			return (-1);
+	}
+	r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+		       PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd,
+		       IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		return (-1);
+
+	r->sq_head = (unsigned *)(sq + p.sq_off.head);
+	r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_flags = (unsigned *)(sq + p.sq_off.flags);
+	r->sq_array = (unsigned *)(sq + p.sq_off.array);
+	r->cq_head = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	r->sq_local = *r->sq_tail;
+	r->to_submit = 0;
+	return (0);
+}
+
+/*
+ * Register n buffers or n files with the ring; returns 0 or -1
+ */
+int
+uring_register_buffers(struct uring *r, struct iovec *iov, int n)
+{
+	return (syscall(__NR_io_uring_register, r->fd,
+			IORING_REGISTER_BUFFERS, iov, n) < 0 ? -1 : 0);
+}
+
+int
+uring_register_files(struct uring *r, int *fds, int n)
+{
+	return (syscall(__NR_io_uring_register, r->fd,
+			IORING_REGISTER_FILES, fds, n) < 0 ? -1 : 0);
+}
+
+/*
+ * Queue a read or write (op is IORING_OP_READ or IORING_OP_WRITE) of
+ * len bytes at off. With URING_FILE, fd is the index of a registered
+ * file; with URING_BUF, buf must lie in registered buffer bufidx.
+ * The caller must not have more than depth requests outstanding.
+ */
+void
+uring_prep(struct uring *r, int op, int fd, void *buf, unsigned len,
+	   unsigned long long off, int bufidx, unsigned long long data)
+{
+	unsigned		idx = r->sq_local & *r->sq_mask;
+	struct io_uring_sqe	*sqe = &r->sqes[idx];
+
+	bzero((char *)sqe, sizeof(*sqe));
+	if (uring_flags & URING_BUF) {
+		op = (op == IORING_OP_READ) ? IORING_OP_READ_FIXED :
+					      IORING_OP_WRITE_FIXED;
+		sqe->buf_index = bufidx;
+	}
+	sqe->opcode = op;
+	sqe->fd = fd;
+	if (uring_flags & URING_FILE)
+		sqe->flags |= IOSQE_FIXED_FILE;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->user_data = data;
+	r->sq_array[idx] = idx;
+	r->sq_local++;
+	r->to_submit++;
+}
+
+/*
+ * Hand the queued requests to the kernel and, if wait is set, wait for
+ * at least one completion. Returns -1 with errno set on failure.
+ */
+int
+uring_submit(struct uring *r, int wait)
+{
+	unsigned	flags = 0, n = r->to_submit;
+
+	__sync_synchronize();		/* sqes before the tail */
+	*(volatile unsigned *)r->sq_tail = r->sq_local;
+	__sync_synchronize();
+	r->to_submit = 0;
+	if (uring_flags & URING_SQPOLL) {
+		n = 0;
+		if (*(volatile unsigned *)r->sq_flags & IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		else if (!wait)
+			return (0);
+	}
+	if (wait)
+		flags |= IORING_ENTER_GETEVENTS;
+	if (n == 0 && flags == 0)
+		return (0);
+	while (syscall(__NR_io_uring_enter, r->fd, n, wait ? 1 : 0, flags,
+		       NULL, 0) < 0) {
+		if (errno != EINTR)
+			return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Take one completion if there is one: returns 1 and fills in *data
+ * and *res (bytes, or -errno), or returns 0.
+ */
+int
+uring_reap(struct uring *r, unsigned long long *data, int *res)
+{
+	unsigned		head = *r->cq_head;
+	struct io_uring_cqe	*cqe;
+
+	__sync_synchronize();
+	if (head == *(volatile unsigned *)r->cq_tail)
+		return (0);
+	cqe = &r->cqes[head & *r->cq_mask];
+	*data = cqe->user_data;
+	*res = cqe->res;
+	__sync_synchronize();		/* read the cqe before freeing it */
+	*(volatile unsigned *)r->cq_head = head + 1;
+	return (1);
+}
+#endif /* HAVE_URING */
+
+#endif /* __LIB_URING_C__ */
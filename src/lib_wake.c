@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lib_wake.c - one-shot wakeups between threads, for the benchmarks
+ *              that pass a token around
+ *
+ * A wake_slot holds at most one token. wake_post() puts the token in a
+ * slot and wakes its waiter; wake_wait() sleeps until there is a token
+ * and takes it. The mechanism, chosen once for all slots with
+ * parse_wake_mech(), is one of
+ *
+ *	pipe	a pipe per slot; the token is a word written to it
+ *	eventfd	an eventfd per slot (Linux)
+ *	futex	a word per slot, set and cleared atomically; the waiter
+ *		sleeps in FUTEX_WAIT while it is 0 (Linux)
+ *	sem	a POSIX semaphore per slot
+ *
+ * Except for sem, whose sem_post() only enters the kernel when someone
+ * is waiting, wake_post() makes the same system call whether or not
+ * there is a waiter, so its cost can be measured without one.
+ *
+ * Slots are private to one process unless wake_pshared is set before
+ * wake_init(); then slots in shared memory work between processes that
+ * fork after wake_init().
+ */
+#ifndef __LIB_WAKE_C__
+#define __LIB_WAKE_C__
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+#endif
+#ifndef NO_THREADS
+#include <errno.h>
+#include <semaphore.h>
+#endif
+
+#define WAKE_PIPE	0
+#define WAKE_EVENTFD	1
+#define WAKE_FUTEX	2
+#define WAKE_SEM	3
+
+static char *wake_argstring = "pipe|eventfd|futex|sem";
+
+/*
+ * The padding keeps the parts of neighbouring slots that are written
+ * off each other's cache lines.
+ */
+struct wake_slot {
+	volatile int	word;		/* futex: 1 if the token is here */
+	int		fd[2];		/* pipe, or eventfd in fd[0] */
+#ifndef NO_THREADS
+	sem_t		sem;
+#endif
+	char		pad[64];
+};
+
+int	wake_mech = WAKE_PIPE;
+int	wake_pshared = 0;	/* slots are shared between processes */
+
+/*
+ * Select the mechanism by name; returns 0 on success, 1 if it is
+ * unknown or not available on this system.
+ */
+int
+parse_wake_mech(char *s)
+{
+	if (!strcmp(s, "pipe"))
+		wake_mech = WAKE_PIPE;
+#ifdef __linux__
+	else if (!strcmp(s, "eventfd"))
+		wake_mech = WAKE_EVENTFD;
+	else if (!strcmp(s, "futex"))
+		wake_mech = WAKE_FUTEX;
+#endif
+#ifndef NO_THREADS
+	else if (!strcmp(s, "sem"))
+		wake_mech = WAKE_SEM;
+#endif
+	else
+		return (1);
+	return (0);
+}
+
+/*
+ * Set up and tear down n empty slots
+ */
+void
+wake_init(struct wake_slot *s, int n)
+{
+	for (; n > 0; n--, s++) {
+		s->word = 0;
+		switch (wake_mech) {
+		case WAKE_PIPE:
+			if (pipe(s->fd) == -1) {
+				perror("pipe");
+				exit(1);
+			}
+			break;
+#ifdef __linux__
+		case WAKE_EVENTFD:
+			if ((s->fd[0] = eventfd(0, 0)) == -1) {
+				perror("eventfd");
+				exit(1);
+			}
+			break;
+#endif
+#ifndef NO_THREADS
+		case WAKE_SEM:
+			if (sem_init(&s->sem, wake_pshared, 0) == -1) {
+				perror("sem_init");
+				exit(1);
+			}
+			break;
+#endif
+		}
+	}
+}
+
+void
+wake_done(struct wake_slot *s, int n)
+{
+	for (; n > 0; n--, s++) {
+		switch (wake_mech) {
+		case WAKE_PIPE:
+			close(s->fd[1]);
+			/* FALLTHROUGH */
+		case WAKE_EVENTFD:
+			close(s->fd[0]);
+			break;
+#ifndef NO_THREADS
+		case WAKE_SEM:
+			sem_destroy(&s->sem);
+			break;
+#endif
+		}
+	}
+}
+
+/*
+ * Put the token in slot s
+ */
+void
+wake_post(struct wake_slot *s)
+{
+	int msg = 0;
+#ifdef __linux__
+	unsigned long long one = 1;
+#endif
+
+	switch (wake_mech) {
+	case WAKE_PIPE:
+		if (write(s->fd[1], &msg, sizeof(msg)) != sizeof(msg)) {
+			perror("write on pipe");
+			exit(1);
+		}
+		break;
+#ifdef __linux__
+	case WAKE_EVENTFD:
+		if (write(s->fd[0], &one, sizeof(one)) != sizeof(one)) {
+			perror("write on eventfd");
+			exit(1);
+		}
+		break;
+	case WAKE_FUTEX:
+		__sync_lock_test_and_set(&s->word, 1);
+		syscall(SYS_futex, &s->word, wake_pshared ? FUTEX_WAKE :
+			FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+		break;
+#endif
+#ifndef NO_THREADS
+	case WAKE_SEM:
+		sem_post(&s->sem);
+		break;
+#endif
+	}
+}
+
+/*
+ * Wait until there is a token in slot s, and take it
+ */
+void
+wake_wait(struct wake_slot *s)
+{
+	int msg;
+#ifdef __linux__
+	unsigned long long val;
+#endif
+
+	switch (wake_mech) {
+	case WAKE_PIPE:
+		if (read(s->fd[0], &msg, sizeof(msg)) != sizeof(msg)) {
+			perror("read on pipe");
+			exit(1);
+		}
+		break;
+#ifdef __linux__
+	case WAKE_EVENTFD:
+		if (read(s->fd[0], &val, sizeof(val)) != sizeof(val)) {
+			perror("read on eventfd");
+			exit(1);
+		}
+		break;
+	case WAKE_FUTEX:
+		while (!__sync_bool_compare_and_swap(&s->word, 1, 0))
+			syscall(SYS_futex, &s->word, wake_pshared ?
+				FUTEX_WAIT : FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+		break;
+#endif
+#ifndef NO_THREADS
+	case WAKE_SEM:
+		while (sem_wait(&s->sem) == -1) {
+			if (errno != EINTR) {
+				perror("sem_wait");
+				exit(1);
+			}
+		}
+		break;
+#endif
+	}
+}
+
+#endif /* __LIB_WAKE_C__ */
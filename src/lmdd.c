@@ -1,6 +1,34 @@
-/* XXX ABB: add rusage stuff trimmed from timing.c */
-char	*id = "$Id: lmdd.c,v 1.18 1997/06/23 22:09:34 abrown Exp $\n";
 /*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ * Copyright (c) 1994,1995 Larry McVoy.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * This work is derived from, but can no longer be called, lmbench.
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * lmdd.c - a dd(1) that measures: copy, read or write a stream of blocks
+ *
+ * Usage: lmdd [clock_multiplier] [key=value ...]
+ *
  * defaults:
  *	bs=8k
  *	count=forever
@@ -9,52 +37,89 @@ char	*id = "$Id: lmdd.c,v 1.18 1997/06/23 22:09:34 abrown Exp $\n";
  *	ipat=0
  *	opat=0
  *	mismatch=0
- *	rusage=0
  *	flush=0
  *	rand=0
  *	print=0
  *	label=""
+ *	aio=none
+ *	qd=1
+ *	direct=0
+ *	fsync=0
+ *	fdatasync=0
+ *	syncevery=0
+ *	interval=0
  * shorthands:
- *	recognizes 'k' or 'm' at the end of a number for 1024 & 1024^2
+ *	recognizes 'k', 'm' or 'g' at the end of a number for 1024,
+ *	1024^2 and 1024^3
  *	recognizes "internal" as an internal /dev/zero /dev/null file.
  *
- * Copyright (c) 1994,1995 Larry McVoy.  All rights reserved.
+ * Blocks are read from "if" and written to "of"; an internal input
+ * makes blocks of zeroes (or the opat pattern) and an internal output
+ * throws them away. With aio=posix (POSIX aio_read()/aio_write()) or
+ * aio=uring (a Linux io_uring), up to qd blocks are in flight at once;
+ * each block is written as soon as its read completes, at the same
+ * offset, so both files must be seekable. With the default, aio=none,
+ * one read() and one write() are done at a time.
+ *
+ * direct=1 opens the files O_DIRECT, so bs must suit the device.
+ * fsync=1 or fdatasync=1 syncs the output before the clock stops, and
+ * syncevery=N also does so every N blocks written. flush=1 drops the
+ * output file from the cache afterwards (untimed), so that it can be
+ * read back from the disk. interval=ms prints a timeline on stdout:
+ * one line per interval with the time since the start in seconds and
+ * the MB/s moved during the interval. print= selects the summary:
+ *
+ *	0	none
+ *	1	blocks, time, ms per block and KB/s (stderr)
+ *	2	microseconds per block (stderr)
+ *	3	KB/s (stderr)
+ *	4	MB/s (stderr)
+ *	5	MB moved and MB/s, for xgraph (stderr)
+ *	6	MB/s on stdout, like the bandwidth benchmarks
+ *	other	MB moved, time and MB/s (stderr)
+ *
+ * Builds with cycle or event counters take the clock multiplier first.
+ *
+ * Based on:
+ *	$lmbenchId: lmdd.c,v 1.18 1997/06/23 22:09:34 abrown Exp $
  */
+char	*id = "$Id$\n";
 
-#include	"timing.c"
+#include "common.c"
+#include "lib_uring.c"
 
-#ifdef	FLUSH
-#include	<unistd.h>
-#include	<sys/mman.h>
-#include	<sys/stat.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#if defined(_POSIX_ASYNCHRONOUS_IO) && _POSIX_ASYNCHRONOUS_IO > 0
+#include <aio.h>
+#define HAVE_POSIX_AIO
 #endif
 
-#include	<fcntl.h>
+#define AIO_NONE	0
+#define AIO_POSIX	1
+#define AIO_URING	2
 
-#ifdef	sgi
-#define	AIO	10
-#ifdef	AIO
-#include	<aio.h>
-#endif
-#endif
+#define MAX_QD		256
 
-#define	USE_VALLOC
-#ifdef	USE_VALLOC
-#define	VALLOC	valloc
-#else
-#define	VALLOC	malloc
-#endif
+#define SLOT_FREE	0
+#define SLOT_READ	1
+#define SLOT_WRITE	2
 
-int     out, Print, Fsync, Sync, Flush, Rand, Bsize, ru, c;/* done needs it */
-char	*Label;
-#ifdef	AIO
-int	Aios;
-struct aiocb aios[AIO];
-struct aiocb *a;
-int	next_aio = 0;
+/*
+ * One block buffer and the request it is part of
+ */
+struct slot {
+	uint		*buf;
+	off_t		off;		/* where in the files */
+	int		len;		/* bytes to write */
+	int		state;		/* SLOT_* */
+	int		res;		/* aio=none: result of the call */
+#ifdef HAVE_POSIX_AIO
+	struct aiocb	cb;
 #endif
+};
 
-long	getarg();
 char   *cmds[] = {
 	"if",			/* input file */
 	"of",			/* output file */
@@ -65,48 +130,75 @@ char   *cmds[] = {
 	"count",		/* number of blocks */
 	"skip",			/* skip this number of blocks on input */
 	"fsync",		/* fsync output before exit */
+	"fdatasync",		/* fdatasync output before exit */
+	"syncevery",		/* and every this many blocks */
 	"sync",			/* sync output before exit */
 	"print",		/* report type */
 	"label",		/* prefix print out with this */
 	"move",			/* instead of count, limit transfer to this */
 	"rand",			/* do randoms over the specified size */
-				/* must be power of two, not checked */
-#ifdef	RUSAGE
-	"rusage",		/* dump rusage stats */
-#endif
-#ifdef	FLUSH
-	"flush",		/* map in out and invalidate (flush) */
-#endif
-#ifdef	sgi
+	"flush",		/* drop output from the cache afterwards */
 	"direct",		/* O_DIRECT */
-#endif
-#ifdef	AIO
-	"aios",			/* multiple writers */
-#endif
+	"aio",			/* none, posix or uring */
+	"qd",			/* blocks in flight */
+	"interval",		/* timeline interval, ms */
 	0,
 };
 
+/*
+ * Settings and state; the signal handler needs some of them
+ */
+int	in, out, Print, Fsync, Fdatasync, Syncevery, Sync, Flush, Direct;
+int	Bsize, Aio, Qd, Interval;
+long long Rand;
+char	*Label;
+char	*output;
+volatile int interrupted = 0;
+
+struct slot	slots[MAX_QD];
+#ifdef HAVE_URING
+struct uring	ring;
+#endif
+
+long long	getarg();
+char		*getstr();
+int		getfile();
+void		chkarg();
+void		intr();
+void		io_start();
+struct slot	*io_reap();
+void		sync_output();
+void		report();
+void		error();
+
+int
 main(ac, av)
 	int	ac;
 	char  **av;
 {
-	uint  *buf;
-	int     misses, mismatch, outpat, inpat, in, gotcnt, count;
-	int     skip;
-	long	size;
-	void    done();
-	void	chkarg();
-	long     i;
-	off_t	off = 0;
-
-	if (sizeof(int) != 4) {
-		fprintf(stderr, "sizeof(int) != 4\n");
+	struct slot	*s;
+	uint		*buf;
+	int		misses, mismatch, outpat, inpat, gotcnt;
+	int		i, x, k, inflight, eof, nwrites;
+	long long	count, move, skip, nrand;
+	unsigned long long moved, imoved;
+	off_t		next_off;
+	clk_t		t, t0, ilast, now;
+	char		*a;
+
+	/* print out RCS ID to stderr*/
+	fprintf(stderr, "%s", id);
+
+	/* Check command-line arguments */
+	if (parse_counter_args(&ac, &av)) {
+		fprintf(stderr, "usage: %s%s [key=value ...]\n", av[0],
+			counter_argstring);
 		exit(1);
 	}
 	for (i = 1; i < ac; ++i) {
 		chkarg(av[i]);
 	}
-	signal(SIGINT, done);
+	signal(SIGINT, intr);
 	misses = mismatch = getarg("mismatch=", ac, av);
 	inpat = getarg("ipat=", ac, av);
 	outpat = getarg("opat=", ac, av);
@@ -114,29 +206,19 @@ main(ac, av)
 	if (Bsize < 0)
 		Bsize = 8192;
 	Fsync = getarg("fsync=", ac, av);
+	Fdatasync = getarg("fdatasync=", ac, av);
+	Syncevery = getarg("syncevery=", ac, av);
 	Sync = getarg("sync=", ac, av);
 	Rand = getarg("rand=", ac, av);
 	Print = getarg("print=", ac, av);
-	Label = (char *)getarg("label=", ac, av);
-	if (Rand != -1) {
-		size = (Rand - 1) & ~511;
-	}
-#ifdef	RUSAGE
-	ru = getarg("rusage=", ac, av);
-#endif
-	count = getarg("count=", ac, av);
-	i = getarg("move=", ac, av);
-	if (i > 0)
-		count = i / Bsize;
-
-#ifdef	FLUSH
+	Label = getstr("label=", ac, av);
 	Flush = getarg("flush=", ac, av);
-#endif
-	if (count < 0)
-		gotcnt = 0;
-	else
-		gotcnt = 1;
-	c = 0;
+	Direct = getarg("direct=", ac, av) > 0;
+	Interval = getarg("interval=", ac, av);
+	count = getarg("count=", ac, av);
+	if ((move = getarg("move=", ac, av)) != -1)
+		count = move / Bsize;
+	gotcnt = count >= 0;
 	skip = getarg("skip=", ac, av);
 
 	if ((inpat != -1 || outpat != -1) && (Bsize & 3)) {
@@ -147,147 +229,375 @@ main(ac, av)
 		fprintf(stderr, "Block size must be at least 4.\n");
 		exit(1);
 	}
-#ifdef	AIO
-	Aios = getarg("aios=", ac, av);
-	if (Aios > AIO) {
-		printf("Only %d aios supported\n", AIO);
+	if (Rand != -1 && (nrand = Rand / Bsize) < 1) {
+		fprintf(stderr, "rand must be at least the block size\n");
 		exit(1);
 	}
-	if (Aios <= 0) {
-		Aios = 1;
+
+	Aio = AIO_NONE;
+	if ((a = getstr("aio=", ac, av)) != NULL) {
+		if (!strcmp(a, "posix"))
+			Aio = AIO_POSIX;
+		else if (!strcmp(a, "uring"))
+			Aio = AIO_URING;
+		else if (strcmp(a, "none")) {
+			fprintf(stderr, "aio must be none, posix or uring\n");
+			exit(1);
+		}
 	}
-	if (Aios > 1) {
-		aio_init();
+#ifndef HAVE_POSIX_AIO
+	if (Aio == AIO_POSIX) {
+		fprintf(stderr, "aio=posix: not supported on this system\n");
+		exit(1);
 	}
-	bzero(aios, sizeof(aios));
-	for (i = 0; i < Aios; ++i) {
 #endif
-	if (!(buf = (uint *) VALLOC((unsigned) Bsize))) {
-		perror("VALLOC");
+#ifndef HAVE_URING
+	if (Aio == AIO_URING) {
+		fprintf(stderr, "aio=uring: not supported on this system\n");
 		exit(1);
 	}
-	bzero((char *) buf, Bsize);
-#ifdef	AIO
-	aios[i].aio_buf = buf;
-	}
 #endif
-
-	start();
-	/*
-	 * We want this here because otherwise the accounting gets screwed up
-	 */
-	in = getfile("if=", ac, av);
-	out = getfile("of=", ac, av);
-	if (skip > 0) {
-		lseek(in, skip * Bsize, 0);
+	Qd = getarg("qd=", ac, av);
+	if (Qd < 1)
+		Qd = 1;
+	if (Aio == AIO_NONE)
+		Qd = 1;
+	if (Qd > MAX_QD) {
+		fprintf(stderr, "Only %d blocks in flight supported\n",
+			MAX_QD);
+		exit(1);
 	}
-	for (;;) {
-		register x;
 
-		if (gotcnt && count-- <= 0) {
-			done();
+	/* Aligned, for O_DIRECT */
+	for (i = 0; i < Qd; ++i) {
+		if (posix_memalign((void **)&slots[i].buf, 4096, Bsize)) {
+			perror("posix_memalign");
+			exit(1);
 		}
+		bzero((char *) slots[i].buf, Bsize);
+	}
 
-#ifdef	AIO
-		if (Aios > 1) {
-			if (++next_aio == Aios) {
-				next_aio = 0;
-			}
-			a = &aios[next_aio];
-			buf = a->aio_buf;
-			if (a->aio_nbytes) {
-				int	n;
-
-				aio_suspend(&a, 1, 0);
-				n = aio_return(a);
-				if (n != a->aio_nbytes) {
-					printf("aio%d wanted %d got %d\n",
-					   next_aio, a->aio_nbytes, n);
-					done();
-#if 0
-				} else {
-					printf("aio %x @ %d worked\n", 
-					    a->aio_buf, a->aio_offset);
-#endif
-				}
-			}
-			a->aio_nbytes = 0;
-		}
+	in = getfile("if=", ac, av);
+	out = getfile("of=", ac, av);
+	if (Aio != AIO_NONE && (in == 0 || out == 1 || out == 2)) {
+		fprintf(stderr, "aio needs seekable files\n");
+		exit(1);
+	}
+#ifdef HAVE_URING
+	if (Aio == AIO_URING && uring_init(&ring, Qd) == -1) {
+		perror("io_uring_setup");
+		exit(1);
+	}
 #endif
 
+	/* initialize timing module (calculates timing overhead, etc) */
+	init_timing();
+
+	start();
+	t0 = ilast = read_clock();
+	next_off = skip > 0 ? skip * Bsize : 0;
+	if (Aio == AIO_NONE && Rand == -1 && in >= 0 && next_off > 0)
+		lseek(in, next_off, 0);
+	moved = imoved = 0;
+	inflight = eof = nwrites = 0;
+	for (;;) {
 		/*
-		 * Set the seek pointer if doing randoms
+		 * Start as many blocks as there are free slots
 		 */
-		if (Rand != -1) {
-			off = lrand48() & size;
+		for (i = 0; i < Qd && inflight < Qd; i++) {
+			if (eof || interrupted || (gotcnt && count <= 0))
+				break;
+			s = &slots[i];
+			if (s->state != SLOT_FREE)
+				continue;
+			if (gotcnt)
+				count--;
+			if (Rand != -1)
+				s->off = (off_t)(lrand48() % nrand) * Bsize;
+			else {
+				s->off = next_off;
+				next_off += Bsize;
+			}
+			inflight++;
 			if (in >= 0) {
-				lseek(in, off, 0);
+				io_start(s, SLOT_READ);
+				continue;
 			}
+			if (outpat != -1)
+				for (k = 0; k < Bsize / sizeof(int); k++)
+					s->buf[k] = (uint)(s->off +
+							   k * sizeof(int));
 			if (out >= 0) {
-				lseek(out, off, 0);
+				s->len = Bsize;
+				io_start(s, SLOT_WRITE);
+				continue;
 			}
+			moved += Bsize;		/* internal to internal */
+			inflight--;
 		}
+		if (inflight == 0)
+			break;
 
-#ifdef	AIO
-		if (Aios > 1) {
-			a->aio_offset = off;
-		}
-#endif
-
-		if (in >= 0) {
-			x = read(in, buf, Bsize);
-		} else {
-			x = Bsize;
-		}
-		if (x <= 0) {
-			done();
-		}
-		if (inpat != -1) {
-			register foo, cnt;
-
-			for (foo = 0, cnt = x/sizeof(int); cnt--; foo++) {
-				if (buf[foo] != (uint) (off + foo*sizeof(int))) {
+		/*
+		 * Finish one
+		 */
+		s = io_reap(&x);
+		buf = s->buf;
+		if (s->state == SLOT_READ) {
+			if (Aio == AIO_NONE && Rand == -1 && x > 0)
+				next_off = s->off + x;	/* short reads */
+			if (x <= 0) {
+				if (x < 0) {
+					errno = -x;
+					perror("read");
+				}
+				eof = 1;
+				s->state = SLOT_FREE;
+				inflight--;
+				continue;
+			}
+			if (inpat != -1 && (mismatch == -1 || misses > 0)) {
+				for (k = 0; k < x / sizeof(int); k++) {
+					if (buf[k] == (uint)(s->off +
+							     k * sizeof(int)))
+						continue;
 					fprintf(stderr,
 					    "off=%uK want=%x (%uK) got=%x (%uK)\n",
-					    off >> 10,
-					    off + foo*sizeof(int),
-					    (off + foo*sizeof(int)) >> 10,
-					    buf[foo], buf[foo] >> 10);
+					    (uint)(s->off >> 10),
+					    (uint)(s->off + k*sizeof(int)),
+					    (uint)((s->off + k*sizeof(int)) >> 10),
+					    buf[k], buf[k] >> 10);
 					if (mismatch != -1 && --misses == 0) {
-						done();
+						eof = 1;
+						break;
 					}
 				}
 			}
+			if (out >= 0) {
+				if (outpat != -1)
+					for (k = 0; k < x / sizeof(int); k++)
+						buf[k] = (uint)(s->off +
+								k * sizeof(int));
+				s->len = x;
+				io_start(s, SLOT_WRITE);
+				continue;
+			}
+		} else {
+			if (x != s->len) {
+				if (x < 0) {
+					errno = -x;
+					perror("write");
+				}
+				eof = 1;
+				x = x > 0 ? x : 0;
+			}
+			if (Syncevery > 0 && ++nwrites % Syncevery == 0)
+				sync_output();
 		}
-		if (outpat != -1) {
-			register foo, cnt;
-
-			for (foo = 0, cnt = x/sizeof(int); cnt--; foo++) {
-				buf[foo] = (uint)(off + foo*sizeof(int));
+		moved += x;
+		s->state = SLOT_FREE;
+		inflight--;
+
+		if (Interval > 0) {
+			now = read_clock();
+			if ((now - ilast) * clock_multiplier >=
+			    Interval * 1000.0) {
+				printf("%.3f ", (now - t0) * clock_multiplier /
+				       1000000.0);
+				print_bandwidth((double)(moved - imoved),
+						now - ilast);
+				printf("\n");
+				fflush(stdout);
+				ilast = now;
+				imoved = moved;
 			}
 		}
-		if (out >= 0) {
-#ifdef	AIO
-			if (Aios > 1) {
-				a->aio_nbytes = x;
-				a->aio_fildes = out;
-				if (aio_write(a)) {
-					perror("aio_write");
-					done();
-				}
-			} else {
-				if (write(out, buf, x) != x) {
-					done();
+	}
+
+	if (Sync > 0)
+		sync();
+	if (Fsync > 0 || Fdatasync > 0)
+		sync_output();
+	t = stop(NULL);
+#ifdef POSIX_FADV_DONTNEED
+	if (Flush > 0 && out >= 0)
+		posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	report((double)moved, t);
+	exit(0);
+}
+
+/*
+ * Start a read of a block into s, or a write of s->len bytes from it
+ */
+void
+io_start(s, op)
+	struct slot *s;
+	int op;
+{
+	s->state = op;
+	switch (Aio) {
+	case AIO_NONE:
+		if (op == SLOT_READ)
+			s->res = Rand != -1 ? pread(in, s->buf, Bsize, s->off) :
+				 read(in, s->buf, Bsize);
+		else
+			s->res = Rand != -1 ?
+				 pwrite(out, s->buf, s->len, s->off) :
+				 write(out, s->buf, s->len);
+		if (s->res < 0)
+			s->res = -errno;
+		break;
+#ifdef HAVE_POSIX_AIO
+	case AIO_POSIX:
+		bzero((char *)&s->cb, sizeof(s->cb));
+		s->cb.aio_fildes = op == SLOT_READ ? in : out;
+		s->cb.aio_buf = s->buf;
+		s->cb.aio_nbytes = op == SLOT_READ ? Bsize : s->len;
+		s->cb.aio_offset = s->off;
+		if ((op == SLOT_READ ? aio_read(&s->cb) :
+		     aio_write(&s->cb)) == -1) {
+			perror(op == SLOT_READ ? "aio_read" : "aio_write");
+			exit(1);
+		}
+		break;
+#endif
+#ifdef HAVE_URING
+	case AIO_URING:
+		uring_prep(&ring, op == SLOT_READ ? IORING_OP_READ :
+			   IORING_OP_WRITE, op == SLOT_READ ? in : out,
+			   s->buf, op == SLOT_READ ? Bsize : s->len,
+			   s->off, 0, (unsigned long long)(s - slots));
+		break;
+#endif
+	}
+}
+
+/*
+ * Wait for a request to finish; return its slot, with the bytes moved
+ * (or -errno) in *res
+ */
+struct slot *
+io_reap(res)
+	int *res;
+{
+	int i;
+#ifdef HAVE_POSIX_AIO
+	const struct aiocb *list[MAX_QD];
+	int n, err;
+#endif
+#ifdef HAVE_URING
+	unsigned long long data;
+#endif
+
+	switch (Aio) {
+#ifdef HAVE_POSIX_AIO
+	case AIO_POSIX:
+		for (;;) {
+			for (i = n = 0; i < Qd; i++) {
+				if (slots[i].state == SLOT_FREE)
+					continue;
+				err = aio_error(&slots[i].cb);
+				if (err != EINPROGRESS) {
+					*res = aio_return(&slots[i].cb);
+					if (*res < 0)
+						*res = -err;
+					return (&slots[i]);
 				}
+				list[n++] = &slots[i].cb;
 			}
-#else
-			if (write(out, buf, x) != x) {
-				done();
+			if (aio_suspend(list, n, NULL) == -1 &&
+			    errno != EINTR && errno != EAGAIN) {
+				perror("aio_suspend");
+				exit(1);
 			}
+		}
 #endif
+#ifdef HAVE_URING
+	case AIO_URING:
+		/* send any writes queued since the last reap first */
+		if (uring_submit(&ring, 0) == -1) {
+			perror("io_uring_enter");
+			exit(1);
 		}
-		off += x;
-		c += (x >> 2);
+		while (!uring_reap(&ring, &data, res)) {
+			if (uring_submit(&ring, 1) == -1) {
+				perror("io_uring_enter");
+				exit(1);
+			}
+		}
+		return (&slots[data]);
+#endif
+	default:
+		for (i = 0; i < Qd; i++) {
+			if (slots[i].state != SLOT_FREE) {
+				*res = slots[i].res;
+				return (&slots[i]);
+			}
+		}
+		fprintf(stderr, "lmdd: nothing in flight\n");
+		exit(1);
+	}
+}
+
+void
+sync_output()
+{
+	if (out < 0)
+		return;
+	if (Fdatasync > 0)
+		fdatasync(out);
+	else
+		fsync(out);
+}
+
+/*
+ * Print the summary selected by print=
+ */
+void
+report(bytes, t)
+	double bytes;
+	clk_t t;
+{
+	double	s = t * clock_multiplier / 1000000.0;
+	double	bs = bytes / (s > 0 ? s : 1);
+	double	xfers = bytes / Bsize;
+
+	if (Label != NULL)
+		fprintf(stderr, "%s", Label);
+	switch (Print) {
+	case 0:		/* no print out */
+		break;
+	case 1:		/* latency type print out */
+		fprintf(stderr,
+		    "%.0f xfers in %.2f secs, %.4f millisec/xfer, %.2f KB/sec\n",
+		    xfers, s, xfers > 0 ? s * 1000 / xfers : 0.0,
+		    bs / 1024.);
+		break;
+	case 2:		/* microsecond per op print out */
+		fprintf(stderr, ": %.0f microseconds\n",
+			xfers > 0 ? s * 1000000 / xfers : 0.0);
+		break;
+	case 3:		/* kb / sec print out */
+		fprintf(stderr, "%.0f KB/sec\n", bs / 1024.);
+		break;
+	case 4:		/* mb / sec print out */
+		fprintf(stderr, "%.2f MB/sec\n", bs / MB);
+		break;
+	case 5:		/* Xgraph output */
+		fprintf(stderr, "%.4f %.2f\n", bytes / MB, bs / MB);
+		break;
+	case 6:		/* for the driver */
+		output_bandwidth(bytes, t);
+		break;
+	default:	/* bandwidth print out */
+		if ((bs / 1024.) > 1024)
+			fprintf(stderr, "%.2f MB in %.2f secs, %.2f MB/sec\n",
+			    bytes / MB, s, bs / MB);
+		else
+			fprintf(stderr, "%.2f MB in %.2f secs, %.2f KB/sec\n",
+			    bytes / MB, s, bs / 1024.);
+		break;
 	}
 }
 
@@ -301,7 +611,7 @@ chkarg(arg)
 	for (i = 0; cmds[i]; ++i) {
 		for (a = arg, b = cmds[i]; *a && *b && *a == *b; a++, b++)
 			;
-		if (*a == '=')
+		if (*a == '=' && *b == '\0')
 			return;
 	}
 	fprintf(stderr, "Bad arg: %s\n", arg);
@@ -309,199 +619,107 @@ chkarg(arg)
 	/*NOTREACHED*/
 }
 
+/*
+ * On ^C, stop starting blocks; the ones in flight finish and the
+ * summary is printed as usual.
+ */
 void
-done()
+intr(sig)
+	int sig;
 {
-#ifdef	AIO
-	if (Aios > 1) {
-		int	i, n;
-
-		for (i = 0; i < Aios; ++i) {
-			a = &aios[i];
-			if (a->aio_nbytes) {
-				aio_suspend(&a, 1, 0);
-				n = aio_return(a);
-				if (n != a->aio_nbytes) {
-					printf("aio%d wanted %d got %d\n",
-					   next_aio, a->aio_nbytes, n);
-#if 0
-				} else {
-					printf("aio %d worked\n", n);
-#endif
-				}
-			}
-			a->aio_nbytes = 0;
-		}
-	}
-#endif
-	if (Sync > 0)
-		sync();
-	if (Fsync > 0)
-		fsync(out);
-#ifdef	FLUSH
-	if (Flush > 0)
-		flush();
-#endif
-	stop();
-#ifdef	RUSAGE
-	if (ru != -1)
-		rusage();
-#endif
-	if ((long)Label != -1) {
-		fprintf(stderr, "%s", Label);
-	}
-	switch (Print) {
-	    case 0:	/* no print out */
-	    	break;
-
-	    case 1:	/* latency type print out */
-		latency((c << 2) / Bsize, Bsize);
-		break;
-
-	    case 2:	/* microsecond per op print out */
-		micro("", (c << 2) / Bsize);
-		break;
-
-	    case 3:	/* kb / sec print out */
-		kb(c << 2);
-		break;
+	interrupted = 1;
+}
 
-	    case 4:	/* mb / sec print out */
-		mb(c << 2);
+long long
+getarg(s, ac, av)
+	char   *s;
+	int	ac;
+	char  **av;
+{
+	char	*v;
+	long long bs;
+
+	if ((v = getstr(s, ac, av)) == NULL)
+		return (-1);
+	bs = atoll(v);
+	switch (lastchar(v)) {
+	case 'k':
+		bs *= 1024;
 		break;
-
-	    case 5:	/* Xgraph output */
-		bandwidth(c << 2, 0);
+	case 'm':
+		bs *= 1024 * 1024;
 		break;
-
-	    default:	/* bandwidth print out */
-		bandwidth(c << 2, 1);
+	case 'g':
+		bs *= 1024 * 1024 * 1024LL;
 		break;
 	}
-	exit(0);
+	return (bs);
 }
 
-long
-getarg(s, ac, av)
+char *
+getstr(s, ac, av)
 	char   *s;
+	int	ac;
 	char  **av;
 {
-	register len, i;
+	int	len, i;
 
 	len = strlen(s);
-
 	for (i = 1; i < ac; ++i)
-		if (!strncmp(av[i], s, len)) {
-			register bs = atoi(&av[i][len]);
-
-			if (rindex(&av[i][len], 'k'))
-				bs *= 1024;
-			else if (rindex(&av[i][len], 'm'))
-				bs *= (1024 * 1024);
-			if (!strncmp(av[i], "label", 5)) {
-				return (long)(&av[i][len]);	/* HACK */
-			}
-			return (bs);
-		}
-	return (-1);
+		if (!strncmp(av[i], s, len))
+			return (&av[i][len]);
+	return (NULL);
 }
 
-char	*output;
-
+int
 getfile(s, ac, av)
 	char   *s;
+	int	ac;
 	char  **av;
 {
-	register ret, len, i;
-
-	len = strlen(s);
-
-	for (i = 1; i < ac; ++i) {
-		if (!strncmp(av[i], s, len)) {
-			if (av[i][0] == 'o') {
-				if (!strcmp("of=internal", av[i]))
-					return (-2);
-				if (!strcmp("of=stdout", av[i]))
-					return (1);
-				if (!strcmp("of=1", av[i]))
-					return (1);
-				if (!strcmp("of=-", av[i]))
-					return (1);
-				if (!strcmp("of=stderr", av[i]))
-					return (2);
-				if (!strcmp("of=2", av[i]))
-					return (2);
-				ret = creat(&av[i][len], 0644);
-#ifdef	sgi
-				if (getarg("direct=", ac, av) != -1) {
-					close(ret);
-					ret = open(&av[i][len], O_WRONLY|O_DIRECT);
-				}
-#endif
-				if (ret == -1)
-					error(&av[i][len]);
-				output = &av[i][len];
-				return (ret);
-			} else {
-				if (!strcmp("if=internal", av[i]))
-					return (-2);
-				if (!strcmp("if=stdin", av[i]))
-					return (0);
-				if (!strcmp("if=0", av[i]))
-					return (0);
-				if (!strcmp("if=-", av[i]))
-					return (0);
-				ret = open(&av[i][len], 0);
-#ifdef	sgi
-				if (getarg("direct=", ac, av) != -1) {
-					close(ret);
-					ret = open(&av[i][len], O_RDONLY|O_DIRECT);
-				}
-#endif
-				if (ret == -1)
-					error(&av[i][len]);
-				return (ret);
-			}
-		}
-	}
-	return (-2);
-}
-
-#ifdef	FLUSH
-flush()
-{
-	int	fd;
-	struct	stat sb;
-	caddr_t	where;
-
-	if (output == NULL || (fd = open(output, 2)) == -1) {
-		warning("No output file");
-		return;
+	int	ret, flags;
+	char	*f;
+
+	if ((f = getstr(s, ac, av)) == NULL)
+		return (-2);
+	if (s[0] == 'o') {
+		if (!strcmp("internal", f))
+			return (-2);
+		if (!strcmp("stdout", f) || !strcmp("1", f) ||
+		    !strcmp("-", f))
+			return (1);
+		if (!strcmp("stderr", f) || !strcmp("2", f))
+			return (2);
+		flags = O_WRONLY|O_CREAT|O_TRUNC;
+	} else {
+		if (!strcmp("internal", f))
+			return (-2);
+		if (!strcmp("stdin", f) || !strcmp("0", f) ||
+		    !strcmp("-", f))
+			return (0);
+		flags = O_RDONLY;
 	}
-	if (fstat(fd, &sb) == -1 || sb.st_size == 0) {
-		warning(output);
-		return;
+#ifdef O_DIRECT
+	if (Direct)
+		flags |= O_DIRECT;
+#else
+	if (Direct) {
+		fprintf(stderr, "direct: not supported on this system\n");
+		exit(1);
 	}
-	where = mmap(0, sb.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-	msync(where, sb.st_size, MS_INVALIDATE);
-	/* XXX - didn't unmap */
-}
 #endif
-
-warning(s)
-	char   *s;
-{
-	if ((long)Label != -1) {
-		fprintf(stderr, "%s: ", Label);
-	}
-	perror(s);
-	return (-1);
+	if ((ret = open(f, flags, 0644)) == -1)
+		error(f);
+	if (s[0] == 'o')
+		output = f;
+	return (ret);
 }
 
+void
 error(s)
 	char   *s;
 {
-	if ((long)Label != -1) {
+	if (Label != NULL) {
 		fprintf(stderr, "%s: ", Label);
 	}
 	perror(s);
@@ -27,7 +27,11 @@
 /*
  * memsize.c - figure out how much memory we have to use.
  *
- * Usage: memsize [max_wanted_in_MB]
+ * Usage: memsize [-P 4k|thp|2m|1g] [max_wanted_in_MB]
+ *
+ * With -P, the memory is allocated under that page policy (see
+ * lib_pagealloc.c), so with 2m or 1g the result is the number of MB of
+ * reserved huge pages that can be used.
  *
  * Based on:
  *	$lmbenchId: memsize.c,v 1.6 1995/10/26 01:03:42 lm Exp $
@@ -40,6 +44,7 @@ void timeit(char *where, int size);
 void touch(char *p, char *end, int range);
 
 #include "common.c"
+#include "lib_pagealloc.c"
 
 #define	CHK(x)	if ((x) == -1) { perror("x"); exit(1); }
 
@@ -55,9 +60,10 @@ main(ac, av)
 	size_t	size;
 	size_t	max;
 
-	if (parse_counter_args(&ac, &av) || ac > 2) {
-		fprintf(stderr, "usage: %s%s [maxmemsizeinMB]\n",
-			av[0], counter_argstring);
+	if (parse_counter_args(&ac, &av) || parse_page_args(&ac, &av) ||
+	    ac > 2) {
+		fprintf(stderr, "usage: %s%s%s [maxmemsizeinMB]\n",
+			av[0], counter_argstring, page_argstring);
 		exit(1);
 	}
 	if (ac == 2) {
@@ -68,22 +74,27 @@ main(ac, av)
 	/*
 	 * Binary search down and then linear search up
 	 */
-	for (where = 0; !where; where = malloc(size)) {
+	for (where = 0; !where; where = page_alloc(size)) {
 		size >>= 1;
+		if (size < 1024*1024) {
+			fprintf(stderr, "no memory available\n");
+			printf("0\n");
+			exit(0);
+		}
 	}
-	free(where);
+	page_free(where, size);
 	tmp = 0;
 	do {
 		if (tmp) {
-			free(tmp);
+			page_free(tmp, size);
 		}
 		size += 1024*1024;
-		tmp = malloc(size);
+		tmp = page_alloc(size);
 		if (tmp) {
 			where = tmp;
 		} else {
 			size -= 1024*1024;
-			tmp = malloc(size);
+			where = tmp = page_alloc(size);
 			break;
 		}
 	} while (tmp && (size < max));
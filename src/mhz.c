@@ -70,9 +70,12 @@ main(ac, av)
 		fprintf(stderr, "Usage: %s [-c]\n", av[0]);
 	}
 
-	/* initialize timing module (calculates timing overhead, etc) */
+	/*
+	 * initialize timing module (calculates timing overhead, etc).
+	 * clock_multiplier keeps its default: 1.0 for counters, or the
+	 * tick size of the monotonic clock.
+	 */
 	init_timing();
-	clock_multiplier = 1.0;
 
 	/*
 	 * Generate the appropriate number of iterations so the test takes
@@ -103,7 +106,7 @@ main(ac, av)
 	/* remove overhead */
 	totaltime -= overhead;
 
-	mhz = ((double)niter*1000.0) / (double) totaltime;
+	mhz = ((double)niter*1000.0) / ((double)totaltime * clock_multiplier);
 
 	if (ac == 2 && !strcmp(av[1], "-c")) {
 		printf("%.4f\n", 1000 / mhz);
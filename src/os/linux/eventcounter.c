@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 1997 The President and Fellows of Harvard College.
+ * All rights reserved.
+ * Copyright (c) 1997 Aaron B. Brown.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program, in the file COPYING in this distribution;
+ *   if not, write to the Free Software Foundation, Inc., 675 Mass Ave,
+ *   Cambridge, MA 02139, USA.
+ *
+ * Results obtained from this benchmark may be published only under the
+ * name "HBench-OS".
+ */
+
+/*
+ * eventcounter.c -- event counters through the Linux perf_event_open(2)
+ *                   interface.
+ *
+ * Events are selected by name, using the same names as perf(1):
+ * "cycles", "instructions", "LLC-load-misses", "dTLB-load-misses", and
+ * so on (see perfevent_names below), or as raw hardware event codes
+ * written "rNNNN" (or "0xNNNN") in hex. A ":u" or ":k" suffix restricts
+ * counting to user or kernel mode.
+ *
+ * All selected events are opened as a single group with the first as
+ * leader, so the kernel schedules them onto the PMU together. If the PMU
+ * has to multiplex the group with other users, the counts are scaled by
+ * the fraction of the interval the group was actually running.
+ *
+ * The events are inherited: threads and processes the benchmark creates
+ * after selecting them (the workers of -t, the process ring of lat_ctx2,
+ * and so on) are counted along with it, on any CPU. The kernel does not
+ * allow group reads of inherited events, so each counter is read on its
+ * own.
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifndef __linux__
+#  error perf_event event counters are only supported under Linux
+#endif
+
+typedef unsigned long long eventcounter_t;
+#define EVENTCOUNTERTFMT	"%llu"
+#define EVENTCOUNTERTSTR(x)	((eventcounter_t)strtoull(x, NULL, 10))
+
+/*
+ * Most PMUs have 4-8 general-purpose counters; a larger group can never
+ * be scheduled at once.
+ */
+#define MAX_EVENTCOUNTERS	8
+
+#define HWCACHE(c, op, res) ((c) | ((op) << 8) | ((res) << 16))
+
+static struct perfevent_name {
+	char		*name;
+	u_int32_t	type;
+	u_int64_t	config;
+} perfevent_names[] = {
+	{"cycles",		PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instructions",	PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"cache-references",	PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+	{"cache-misses",	PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{"branches",		PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+	{"branch-misses",	PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"bus-cycles",		PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES},
+	{"ref-cycles",		PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES},
+	{"stalled-cycles-frontend", PERF_TYPE_HARDWARE,
+	 PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+	{"stalled-cycles-backend", PERF_TYPE_HARDWARE,
+	 PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+
+	{"L1-dcache-loads",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"L1-dcache-load-misses", PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"L1-dcache-stores",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_WRITE,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"L1-icache-load-misses", PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_L1I, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"LLC-loads",		PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"LLC-load-misses",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"LLC-stores",		PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_WRITE,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"LLC-store-misses",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_WRITE,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"dTLB-loads",		PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"dTLB-load-misses",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"dTLB-stores",		PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"dTLB-store-misses",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"iTLB-load-misses",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_ITLB, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"node-loads",		PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"node-load-misses",	PERF_TYPE_HW_CACHE,
+	 HWCACHE(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ,
+		 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+
+	{"cpu-clock",		PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK},
+	{"task-clock",		PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+	{"page-faults",		PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+	{"minor-faults",	PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN},
+	{"major-faults",	PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ},
+	{"context-switches",	PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+	{"cpu-migrations",	PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+	{NULL, 0, 0}
+};
+
+/* Layout of a read of one counter */
+struct perfevent_reading {
+	u_int64_t	value;
+	u_int64_t	time_enabled;
+	u_int64_t	time_running;
+};
+
+static int perfevent_fd[MAX_EVENTCOUNTERS];
+static int perfevent_nfds = 0;
+static struct perfevent_reading perfevent_start[MAX_EVENTCOUNTERS];
+static struct perfevent_reading perfevent_stop[MAX_EVENTCOUNTERS];
+static int perfevent_bad[MAX_EVENTCOUNTERS];	/* a read of it failed */
+static int perfevent_warned[MAX_EVENTCOUNTERS];
+static eventcounter_t perfevent_val[MAX_EVENTCOUNTERS];
+
+/*
+ * Open the event named by str as counter ctr. Counters must be selected
+ * in order, starting from 0; counter 0 becomes the group leader.
+ */
+void
+select_eventcounter(int ctr, char *str)
+{
+	struct perf_event_attr attr;
+	struct perfevent_name *p;
+	char name[64], *mod, *end;
+	int fd;
+
+	if (ctr != perfevent_nfds || ctr >= MAX_EVENTCOUNTERS) {
+		fprintf(stderr, "eventcounter: at most %d events may be "
+			"selected\n", MAX_EVENTCOUNTERS);
+		exit(1);
+	}
+
+	strncpy(name, str, sizeof(name) - 1);
+	name[sizeof(name) - 1] = '\0';
+	if ((mod = strchr(name, ':')) != NULL)
+		*mod++ = '\0';
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	for (p = perfevent_names; p->name != NULL; p++) {
+		if (!strcmp(p->name, name)) {
+			attr.type = p->type;
+			attr.config = p->config;
+			break;
+		}
+	}
+	if (p->name == NULL) {
+		if (name[0] == 'r' && name[1] != '\0')
+			attr.config = strtoull(name + 1, &end, 16);
+		else if (name[0] == '0' && (name[1] == 'x' || name[1] == 'X'))
+			attr.config = strtoull(name, &end, 16);
+		else
+			end = name;
+		if (*end != '\0') {
+			fprintf(stderr, "eventcounter: unknown event \"%s\"\n",
+				name);
+			exit(1);
+		}
+		attr.type = PERF_TYPE_RAW;
+	}
+	if (mod != NULL) {
+		if (!strcmp(mod, "u"))
+			attr.exclude_kernel = 1;
+		else if (!strcmp(mod, "k"))
+			attr.exclude_user = 1;
+		else {
+			fprintf(stderr, "eventcounter: unknown modifier "
+				"\":%s\"\n", mod);
+			exit(1);
+		}
+	}
+	attr.exclude_hv = 1;
+	attr.inherit = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+	    PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	fd = syscall(__NR_perf_event_open, &attr, 0, -1,
+		     ctr == 0 ? -1 : perfevent_fd[0], 0);
+	if (fd < 0) {
+		fprintf(stderr, "eventcounter: cannot open \"%s\": %s\n",
+			str, strerror(errno));
+		if (errno == EACCES || errno == EPERM)
+			fprintf(stderr, "eventcounter: check "
+				"/proc/sys/kernel/perf_event_paranoid\n");
+		exit(1);
+	}
+	perfevent_fd[perfevent_nfds++] = fd;
+}
+
+/* Nothing is counted unless asked for. */
+#define select_eventcounter_defaults()
+
+/*
+ * Read every counter into r. The cost of the reads lands inside the
+ * timed interval, so it is removed along with the rest of the timing
+ * overhead. A counter that cannot be read is marked bad, and reports
+ * 0 for the interval.
+ */
+static void
+perfevent_read(struct perfevent_reading *r)
+{
+	int i;
+
+	for (i = 0; i < perfevent_nfds; i++) {
+		if (read(perfevent_fd[i], &r[i], sizeof(r[i])) !=
+		    sizeof(r[i])) {
+			memset(&r[i], 0, sizeof(r[i]));
+			perfevent_bad[i] = 1;
+		}
+	}
+}
+
+#define start_eventcounters() do {					\
+	if (perfevent_nfds > 0) {					\
+		memset(perfevent_bad, 0, sizeof(perfevent_bad));	\
+		perfevent_read(perfevent_start);			\
+	}								\
+} while (0)
+
+#define stop_eventcounters() do {					\
+	if (perfevent_nfds > 0) {					\
+		perfevent_read(perfevent_stop);				\
+		perfevent_scale();					\
+	}								\
+} while (0)
+
+/*
+ * Compute the per-interval counts, scaling them up if the group was
+ * multiplexed off the PMU for part of the interval.
+ */
+static void
+perfevent_scale()
+{
+	u_int64_t enabled, running;
+	int i;
+
+	for (i = 0; i < perfevent_nfds; i++) {
+		enabled = perfevent_stop[i].time_enabled -
+		    perfevent_start[i].time_enabled;
+		running = perfevent_stop[i].time_running -
+		    perfevent_start[i].time_running;
+		perfevent_val[i] = perfevent_stop[i].value -
+		    perfevent_start[i].value;
+		if (perfevent_bad[i]) {
+			if (!perfevent_warned[i]++)
+				fprintf(stderr, "eventcounter: cannot read "
+					"counter %d; reporting 0\n", i);
+			perfevent_val[i] = 0;
+		} else if (running == 0)
+			perfevent_val[i] = 0;
+		else if (running < enabled)
+			perfevent_val[i] = (eventcounter_t)
+			    ((double)perfevent_val[i] * enabled / running);
+	}
+}
+
+#define get_eventcounter(ctr) (perfevent_val[(ctr)])
+#define set_eventcounter_val(ctr, val) (perfevent_val[(ctr)] = (val))
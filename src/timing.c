@@ -42,17 +42,41 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#ifdef MONOTONIC_CLOCK
+#include <time.h>
+#endif
 
 #if !defined (CYCLE_COUNTER) && !defined(EVENT_COUNTERS)
+#ifdef MONOTONIC_CLOCK
+typedef	unsigned long long clk_t;	/* nanoseconds need 64 bits */
+#define CLKTFMT		"%llu"
+#define CLKTSTR(x) 	strtoull(x, NULL, 10)
+#else
 typedef	unsigned int clk_t;	/* microseconds can be u_int's */
 #define CLKTFMT		"%d"
 #define CLKTSTR(x) 	atoi(x)
+#endif
 #endif /* COUNTERS */
 
+/*
+ * CLOCK_MONOTONIC_RAW is immune to NTP slewing; older headers only
+ * offer the slewed CLOCK_MONOTONIC.
+ */
+#if defined(MONOTONIC_CLOCK) && !defined(CLOCK_MONOTONIC_RAW)
+#define CLOCK_MONOTONIC_RAW	CLOCK_MONOTONIC
+#endif
+
 clk_t stop(void *unused __attribute__((unused)));
 
+/* Latency sampling support; see utils.c */
+extern unsigned int sample_batch;
+void sample_begin(void);
+void sample_calibrate(void);
+
 #ifdef CYCLE_COUNTER
 static internal_clk_t start_clk, stop_clk;
+#elif defined(MONOTONIC_CLOCK)
+static struct timespec start_ts, stop_ts;
 #else
 static struct timeval start_tv, stop_tv;
 #endif
@@ -75,8 +99,10 @@ clk_t timing_overhead = 0;
 static int
 clktcomp(const void *a, const void *b)
 {
-        /* we assume at most a 30 bit difference! */
-        return (int)((*((clk_t *)a)) - (*((clk_t *)b)));
+	clk_t ca = *((clk_t *)a), cb = *((clk_t *)b);
+
+	/* clk_t may be wider than an int, so don't just subtract */
+	return ((ca > cb) - (ca < cb));
 }
 
 void
@@ -115,9 +141,12 @@ init_timing()
 
 	timing_overhead /= OVERHEAD_OUTER_LOOPS - 2*OVERHEAD_TAILS;
 #ifdef DEBUG
-	printf(">> timing overhead %d\n",timing_overhead);
+	printf(">> timing overhead " CLKTFMT "\n",timing_overhead);
 #endif
 	free(vals);
+
+	if (sample_batch)
+		sample_calibrate();
 }
 
 /*
@@ -128,6 +157,8 @@ start()
 {
 #ifdef CYCLE_COUNTER
 	read_cycle_counter(&start_clk);
+#elif defined(MONOTONIC_CLOCK)
+	(void) clock_gettime(CLOCK_MONOTONIC_RAW, &start_ts);
 #else
 	(void) gettimeofday(&start_tv, (struct timezone *) 0);
 #endif
@@ -140,10 +171,13 @@ start()
 	 */
 	start_eventcounters();
 #endif
+	if (sample_batch)
+		sample_begin();
 }
 
 /*
- * Stop timing and return real time in microseconds.
+ * Stop timing and return real time in clock ticks: cycles with a cycle
+ * counter, nanoseconds with the monotonic clock, microseconds otherwise.
  */
 clk_t
 stop(void *unused __attribute__((unused)))
@@ -153,6 +187,10 @@ stop(void *unused __attribute__((unused)))
 #endif
 #ifdef CYCLE_COUNTER
 	read_cycle_counter(&stop_clk);
+#elif defined(MONOTONIC_CLOCK)
+	long long ns;
+
+	(void) clock_gettime(CLOCK_MONOTONIC_RAW, &stop_ts);
 #else
 	struct timeval tdiff;
 
@@ -165,6 +203,13 @@ stop(void *unused __attribute__((unused)))
 		return (0);
 	else
 		return (((clk_t)(stop_clk - start_clk)) - timing_overhead);
+#elif defined(MONOTONIC_CLOCK)
+	ns = (long long)(stop_ts.tv_sec - start_ts.tv_sec) * 1000000000LL +
+		(stop_ts.tv_nsec - start_ts.tv_nsec);
+	if (ns <= 0 || (clk_t)ns <= timing_overhead)
+		return (0);
+	else
+		return ((clk_t)ns - timing_overhead);
 #else
 	tvsub(&tdiff, &stop_tv, &start_tv);
 	if ((tdiff.tv_sec * 1000000 + tdiff.tv_usec) <= 0 ||
@@ -176,6 +221,32 @@ stop(void *unused __attribute__((unused)))
 #endif /* CYCLE_COUNTER */
 }
 
+/*
+ * Read the clock without disturbing start()/stop(), in the same units
+ * stop() returns. Only differences between two readings are meaningful;
+ * they are correct modulo the width of clk_t.
+ */
+clk_t
+read_clock()
+{
+#ifdef CYCLE_COUNTER
+	internal_clk_t now;
+
+	read_cycle_counter(&now);
+	return ((clk_t)now);
+#elif defined(MONOTONIC_CLOCK)
+	struct timespec now;
+
+	(void) clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	return ((clk_t)now.tv_sec * 1000000000 + now.tv_nsec);
+#else
+	struct timeval now;
+
+	(void) gettimeofday(&now, (struct timezone *) 0);
+	return ((clk_t)now.tv_sec * 1000000 + now.tv_usec);
+#endif
+}
+
 /*
  * Figure out how many iterations of workfn() are needed to make it take
  * one second.
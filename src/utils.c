@@ -44,7 +44,9 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "timing.c"		/* We depend on this for clk_t... */
 
@@ -78,19 +80,230 @@ parse_bytes(s)
 	return (n);
 }
 
+/*
+ * Make sure the process may have at least n open files, raising the soft
+ * limit up to the hard limit if needed. Returns 0 on success, 1 if the
+ * hard limit is too low.
+ */
+int
+raise_fd_limit(n)
+	int	n;
+{
+#ifdef RLIMIT_NOFILE
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= (rlim_t)n)
+		return (0);
+	if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < (rlim_t)n) {
+		fprintf(stderr, "need %d open files, but the limit is %ld\n",
+			n, (long)rl.rlim_max);
+		return (1);
+	}
+	rl.rlim_cur = n;
+	if (setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+		perror("setrlimit");
+		return (1);
+	}
+#endif
+	return (0);
+}
+
+/*
+ * Latency sampling.
+ *
+ * Normally a latency benchmark times its whole loop and reports the
+ * mean. With "-H batch", the benchmark also calls sample_op() inside
+ * its timed loop; every batch operations the elapsed time is recorded
+ * in a histogram, and output_latency() adds p50/p90/p99/p99.9/max
+ * after the mean. A batch of 1 times every operation; larger batches
+ * amortize the cost of reading the clock for very short operations.
+ *
+ * The histogram is log-linear in the style of HdrHistogram: values
+ * below 2*LH_SUB are kept exactly, and each power of two above that is
+ * split into LH_SUB equal buckets, so every recorded value is within
+ * 1/LH_SUB of its true value. It is allocated statically so recording
+ * never touches the allocator.
+ */
+static char *sample_argstring = " [-H batch]";
+
+unsigned int	sample_batch = 0;	/* 0 disables sampling */
+unsigned int	sample_count = 0;	/* operations since last sample */
+clk_t		sample_bias = 0;	/* per-op ticks to discount */
+static clk_t	sample_last;
+static clk_t	sample_overhead = 0;	/* ticks added to a sample's batch */
+static float	sample_cost = 0.0;	/* ticks added to the whole run */
+
+#define LH_SUB_BITS	6
+#define LH_SUB		(1 << LH_SUB_BITS)
+#define LH_NBUCKETS	((8 * sizeof(clk_t) - LH_SUB_BITS + 1) * LH_SUB)
+
+static unsigned int	lh_bucket[LH_NBUCKETS];
+static unsigned int	lh_count;
+static clk_t		lh_max;
+
+/*
+ * Count ops operations just completed; take a sample if a batch is done.
+ */
+#define sample_op(ops) do {						\
+	if (sample_batch && (sample_count += (ops)) >= sample_batch)	\
+		sample_mark();						\
+} while (0)
+
+/*
+ * Parse the sampling option; like parse_counter_args, it consumes its
+ * arguments and leaves av[0] in place. Returns 0 on success, 1 on error.
+ */
+int
+parse_sample_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+
+	if (*acp >= 3 && !strcmp((*avp)[1], "-H")) {
+		sample_batch = atoi((*avp)[2]);
+		if (sample_batch == 0)
+			return (1);
+		*acp -= 2;
+		*avp += 2;
+		(*avp)[0] = av0;
+	}
+	return (0);
+}
+
+void
+latency_hist_reset()
+{
+	bzero(lh_bucket, sizeof(lh_bucket));
+	lh_count = 0;
+	lh_max = 0;
+}
+
+static int
+lh_index(clk_t v)
+{
+	int e;
+
+	for (e = 0; (v >> e) >= 2 * LH_SUB; e++)
+		;
+	return (e * LH_SUB + (int)(v >> e));
+}
+
+/* Highest value that falls into bucket idx */
+static clk_t
+lh_value(int idx)
+{
+	int e = idx < 2 * LH_SUB ? 0 : idx / LH_SUB - 1;
+
+	return ((((clk_t)(idx - e * LH_SUB)) << e) + ((clk_t)1 << e) - 1);
+}
+
+void
+latency_hist_add(clk_t ticks)
+{
+	lh_bucket[lh_index(ticks)]++;
+	lh_count++;
+	if (ticks > lh_max)
+		lh_max = ticks;
+}
+
+/*
+ * Return the value at percentile pct of the recorded samples.
+ */
+clk_t
+latency_hist_pct(double pct)
+{
+	unsigned int rank, seen = 0;
+	int i;
+
+	rank = (unsigned int)(pct / 100.0 * lh_count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < LH_NBUCKETS; i++) {
+		seen += lh_bucket[i];
+		if (seen >= rank)
+			return (lh_value(i) < lh_max ? lh_value(i) : lh_max);
+	}
+	return (lh_max);
+}
+
+/*
+ * Called by start(): the first batch is timed from here.
+ */
+void
+sample_begin()
+{
+	sample_count = 0;
+	sample_last = read_clock();
+}
+
+/*
+ * Record the per-operation time of the batch just completed.
+ */
+void
+sample_mark()
+{
+	clk_t now = read_clock();
+	clk_t t = now - sample_last;
+
+	t = t > sample_overhead ? t - sample_overhead : 0;
+	t /= sample_count;
+	latency_hist_add(t > sample_bias ? t - sample_bias : 0);
+	sample_count = 0;
+	sample_last = read_clock();
+}
+
+/*
+ * Measure what taking a sample adds to the time of the batch it ends
+ * (the smallest time recorded for an empty batch), and what it adds to
+ * the time of the whole loop.
+ */
+#define SAMPLE_CALIBRATE_LOOPS	1000
+
+void
+sample_calibrate()
+{
+	clk_t t0;
+	int i;
+
+	sample_overhead = 0;
+	latency_hist_reset();
+	t0 = read_clock();
+	sample_begin();
+	for (i = SAMPLE_CALIBRATE_LOOPS; i > 0; i--) {
+		sample_count = 1;
+		sample_mark();
+	}
+	sample_cost = (float)(read_clock() - t0) / SAMPLE_CALIBRATE_LOOPS;
+	sample_overhead = latency_hist_pct(0.0);
+	latency_hist_reset();
+}
+
+#define REPEAT_LATENCY		0
+#define REPEAT_BANDWIDTH	1
+static void repeat_record(clk_t t, double units, int kind);
+
 /*
  * Functions to produce desired output formats
  */
-void 
-output_bandwidth(unsigned int bytes, clk_t ticks)
+void
+print_bandwidth(double bytes, clk_t ticks)
 {
 	float usecs = ((float)ticks)*clock_multiplier;
+
 	if (usecs > 0.0)
-		printf("%.4f", (((float)bytes)/MB)/(((float)usecs)/1000000.));
+		printf("%.4f", (bytes/MB)/(((float)usecs)/1000000.));
 	else
 		printf("%.4f", 0.0);
+}
 
+/*
+ * Finish a bandwidth line: event counters, if any, and the newline
+ */
+void
+output_bandwidth_tail(double bytes)
+{
 #ifdef EVENT_COUNTERS
+	int i;
+
 	/* 
 	 * XXX We assume that the last "start-stop" pair contains all
 	 * of the interesting timing data!
@@ -98,34 +311,69 @@ output_bandwidth(unsigned int bytes, clk_t ticks)
 	 * We print the number of bytes transferred before the counter
 	 * values so that the values actually mean something.
 	 */
-	printf(" %u", bytes);
-	if (eventcounter_active[0])
+	printf(" %.0f", bytes);
+	for (i = 0; i < num_eventcounters; i++)
 		printf(" " EVENTCOUNTERTFMT, 
-		       get_eventcounter(0));
-	if (eventcounter_active[1])
-		printf(" " EVENTCOUNTERTFMT, 
-		       get_eventcounter(1));
+		       get_eventcounter(i));
 #endif
 	printf("\n");
 }
 
+/*
+ * If any latencies were recorded, print p50/p90/p99/p99.9/max of them
+ */
+void
+print_latency_pcts()
+{
+	static double pcts[] = {50.0, 90.0, 99.0, 99.9};
+	int i;
+
+	if (lh_count > 0) {
+		for (i = 0; i < sizeof(pcts)/sizeof(pcts[0]); i++)
+			printf(" %.4f", (float)latency_hist_pct(pcts[i]) *
+			       clock_multiplier);
+		printf(" %.4f", (float)lh_max * clock_multiplier);
+	}
+}
+
+/*
+ * Bytes is a double: a second's worth of memory traffic no longer fits
+ * in 32 bits. A benchmark that records the latency of its individual
+ * requests (bw_file_rd -H) gets their percentiles after the bandwidth.
+ */
+void 
+output_bandwidth(double bytes, clk_t ticks)
+{
+	repeat_record(ticks, bytes, REPEAT_BANDWIDTH);
+	print_bandwidth(bytes, ticks);
+	print_latency_pcts();
+	output_bandwidth_tail(bytes);
+}
+
 void 
 output_latency(clk_t usecs, unsigned int niter)
 {
-	float usec_per_iter = (((float)usecs)/((float)niter))*clock_multiplier;
+	float usec_per_iter;
+#ifdef EVENT_COUNTERS
+	int i;
+#endif
+
+	/* Don't charge the operations for the cost of sampling them */
+	if (lh_count > 0 && usecs > lh_count * sample_cost)
+		usecs -= (clk_t)(lh_count * sample_cost);
+	usec_per_iter = (((float)usecs)/((float)niter))*clock_multiplier;
 	printf("%.4f", usec_per_iter);
+	repeat_record(usecs, niter, REPEAT_LATENCY);
+	print_latency_pcts();
 
 #ifdef EVENT_COUNTERS
 	/* 
 	 * XXX We assume that the last "start-stop" pair contains all
 	 * of the interesting timing data!
 	 */
-	if (eventcounter_active[0])
+	for (i = 0; i < num_eventcounters; i++)
 		printf(" " EVENTCOUNTERTFMT, 
-		       get_eventcounter(0)/(eventcounter_t)niter);
-	if (eventcounter_active[1])
-		printf(" " EVENTCOUNTERTFMT, 
-		       get_eventcounter(1)/(eventcounter_t)niter);
+		       get_eventcounter(i)/(eventcounter_t)niter);
 #endif
 	printf("\n");
 }
@@ -136,7 +384,12 @@ output_latency(clk_t usecs, unsigned int niter)
 void 
 output_latency_ns_fd(clk_t usecs, unsigned int niter, int fd)
 {
-	char buf[96], buf1[32], buf2[32];
+#ifdef EVENT_COUNTERS
+	char buf[64 + 24*MAX_EVENTCOUNTERS];
+	int i;
+#else
+	char buf[64];
+#endif
 
 	float ns_per_iter = (((float)usecs*1000.0)/((float)niter))*clock_multiplier;
 #ifdef EVENT_COUNTERS
@@ -144,14 +397,11 @@ output_latency_ns_fd(clk_t usecs, unsigned int niter, int fd)
 	 * XXX We assume that the last "start-stop" pair contains all
 	 * of the interesting timing data!
 	 */
-	buf1[0] = buf2[0] = '\0';
-	if (eventcounter_active[0])
-		sprintf(buf1, " " EVENTCOUNTERTFMT, 
-			get_eventcounter(0)/(eventcounter_t)niter);
-	if (eventcounter_active[1])
-		sprintf(buf2, " " EVENTCOUNTERTFMT, 
-			get_eventcounter(1)/(eventcounter_t)niter);
-	sprintf(buf, "%.4f %s %s\n", ns_per_iter, buf1, buf2);
+	sprintf(buf, "%.4f", ns_per_iter);
+	for (i = 0; i < num_eventcounters; i++)
+		sprintf(buf + strlen(buf), " " EVENTCOUNTERTFMT, 
+			get_eventcounter(i)/(eventcounter_t)niter);
+	strcat(buf, "\n");
 #else
 	sprintf(buf, "%.4f\n", ns_per_iter);
 #endif
@@ -164,6 +414,26 @@ output_latency_ns_fd(clk_t usecs, unsigned int niter, int fd)
 /*
  * Functions to do center-weighted averaging
  */
+
+/*
+ * Sort n data points and average the middle (1-tailpct)*100 percent
+ */
+static clk_t
+trimmed_mean(clk_t *vals, int n, float tailpct)
+{
+	int i, tailsize;
+	clk_t t;
+
+	qsort(vals, n, sizeof(clk_t), clktcomp);
+
+	tailsize = (int)(((float)n)*tailpct);
+
+	t = 0;
+	for (i = tailsize; i < n - tailsize; i++)
+		t += vals[i];
+	return (t / (n - (2 * tailsize)));
+}
+
 static int 	centeravg_max;
 static clk_t	*centeravg_array = NULL;
 static int	centeravg_cur;
@@ -209,23 +479,93 @@ void
 centeravg_done(t)
 	clk_t *t;
 {
-	int i, tailsize;
-
 	/* Handle case where fewer datapoints are entered */
 	centeravg_max = centeravg_cur;
 	
-	/* Sort the data points */
-	qsort(centeravg_array, centeravg_max, sizeof(clk_t), clktcomp);
-
-	/* Now average the middle (1-centeravg_tailpct)*100 percent */
-	tailsize = (int)(((float)centeravg_max)*centeravg_tailpct);
-
-	*t = 0;
-	for (i = tailsize; i < centeravg_max - tailsize; i++)
-		*t += centeravg_array[i];
-	*t /= centeravg_max - (2 * tailsize);
+	*t = trimmed_mean(centeravg_array, centeravg_max, centeravg_tailpct);
 
 	free(centeravg_array);
 	centeravg_array = NULL;
 	centeravg_max = centeravg_cur = 0;
 }
+
+/*
+ * Repetition.
+ *
+ * The driver takes one data point per invocation of a benchmark. With
+ * "-r runs", the benchmark instead repeats its measurement runs times
+ * in one process, printing one result line per run exactly as that many
+ * invocations would have, so the result files and the analysis scripts
+ * see the same thing. Timing setup, buffer allocation and cache priming
+ * are done once. repeat_done() reports the trimmed mean of the runs on
+ * stderr, using the same 20% policy as scripts/stats-single.
+ */
+static char *repeat_argstring = " [-r runs]";
+
+int		repeat_runs = 1;
+static clk_t	*repeat_array = NULL;
+static int	repeat_cur = 0;
+static int	repeat_kind;		/* REPEAT_LATENCY or REPEAT_BANDWIDTH */
+static double	repeat_units;		/* iterations or bytes per run */
+
+#define REPEAT_TAILPCT	0.2
+
+/*
+ * Parse the repetition option; like parse_counter_args, it consumes its
+ * arguments and leaves av[0] in place. Returns 0 on success, 1 on error.
+ */
+int
+parse_repeat_args(int *acp, char ***avp)
+{
+	char *av0 = (*avp)[0];
+
+	if (*acp >= 3 && !strcmp((*avp)[1], "-r")) {
+		repeat_runs = atoi((*avp)[2]);
+		if (repeat_runs < 1)
+			return (1);
+		*acp -= 2;
+		*avp += 2;
+		(*avp)[0] = av0;
+
+		repeat_array = (clk_t *)malloc(repeat_runs * sizeof(clk_t));
+		if (!repeat_array) {
+			perror("malloc");
+			exit(1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Called by the output routines with each run's result
+ */
+static void
+repeat_record(clk_t t, double units, int kind)
+{
+	if (repeat_array && repeat_cur < repeat_runs) {
+		repeat_array[repeat_cur++] = t;
+		repeat_units = units;
+		repeat_kind = kind;
+	}
+}
+
+void
+repeat_done()
+{
+	clk_t t;
+	float usecs;
+
+	if (repeat_cur < 2)
+		return;
+
+	t = trimmed_mean(repeat_array, repeat_cur, REPEAT_TAILPCT);
+	usecs = ((float)t)*clock_multiplier;
+	if (repeat_kind == REPEAT_LATENCY)
+		fprintf(stderr, "%d runs, trimmed mean %.4f\n", repeat_cur,
+			usecs/((float)repeat_units));
+	else
+		fprintf(stderr, "%d runs, trimmed mean %.4f\n", repeat_cur,
+			usecs > 0.0 ? (repeat_units/MB)/
+			(usecs/1000000.) : 0.0);
+	repeat_cur = 0;
+}